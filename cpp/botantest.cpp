@@ -1,5 +1,7 @@
 #include <botan/rng.h>
 #include <botan/auto_rng.h>
+#include <botan/chacha_rng.h>
+#include <botan/system_rng.h>
 #include <botan/cipher_mode.h>
 #include <botan/hex.h>
 #include <botan/stream_cipher.h>
@@ -11,10 +13,17 @@
 #include <botan/botan.h>
 #include <botan/pk_keys.h>
 #include <botan/pubkey.h>
+#include <botan/pwdhash.h>
+#include <botan/kdf.h>
 #include <iostream>
+#include <functional>
 #include <ctime>
 
-const int numTrials = 5;
+#include "runcontrol.h"
+#include "verify.h"
+#include "parallel.h"
+#include "kdfsweep.h"
+#include "rngsweep.h"
 
 using namespace std;
 
@@ -25,12 +34,10 @@ using namespace std;
  */
 int timeAESOp(string plaintext) {
 	clock_t start;
-	double e_duration=0, d_duration=0;
+	RunController run;
+	Sample e_time, d_time;
 
-	for(int i=0; i<numTrials; i++) {
-
-		// Get RNG
-		Botan::AutoSeeded_RNG rng;
+	while(run.next()) {
 
 		// Get key
 		const vector<uint8_t> key = Botan::hex_decode("2B7E151628AED2A6ABF7158809CF4F3C2B7E151628AED2A6ABF7158809CF4F3C");
@@ -46,7 +53,7 @@ int timeAESOp(string plaintext) {
 		// Time encryption
 		start = clock();
 		cipher->encrypt(pt);
-		e_duration = e_duration + ( clock() - start ) / (double) CLOCKS_PER_SEC;
+		run.record(e_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
 
 		// Copy ciphertext into buffer that will be decrypted
 		Botan::secure_vector<uint8_t> dt(pt);
@@ -55,12 +62,15 @@ int timeAESOp(string plaintext) {
 		// Time decryption
 		start = clock();
 		cipher->decrypt(dt);
-		d_duration = d_duration + ( clock() - start ) / (double) CLOCKS_PER_SEC;
+		run.record(d_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		verify(sameBytes(dt.data(), dt.size(), plaintext.data(), plaintext.length()), "AES round trip");
 
 	}
 
-	cout << "Avg encryption time: " << e_duration/numTrials << endl;
-	cout << "Avg decryption time: " << d_duration/numTrials << endl;
+	run.report("Avg encryption time", e_time);
+	run.report("Avg decryption time", d_time);
+	run.finish();
 
 	return 0;
 }
@@ -72,16 +82,19 @@ int timeAESOp(string plaintext) {
  */
 int timeChaChaOp(string plaintext) {
 	clock_t start;
-	double e_duration=0, d_duration=0;
+	RunController run;
+	Sample e_time, d_time;
 
-	for(int i=0; i<numTrials; i++) {
+	// Get RNG once; its seeding cost is measured separately by timeRNGOp
+	unique_ptr<Botan::RandomNumberGenerator> rng(new Botan::AutoSeeded_RNG);
+
+	while(run.next()) {
 	
 		// Prepare plaintext
 		Botan::secure_vector<uint8_t> pt(plaintext.data(), plaintext.data()+plaintext.length());
 
 		// Setup key and IV
 		const vector<uint8_t> key = Botan::hex_decode("000102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F");
-		unique_ptr<Botan::RandomNumberGenerator> rng(new Botan::AutoSeeded_RNG);
 		vector<uint8_t> iv(8);
 		rng->randomize(iv.data(),iv.size());
 
@@ -95,7 +108,7 @@ int timeChaChaOp(string plaintext) {
 		// Encrypt
 		start = clock();
 		cipher->encipher(pt);
-		e_duration = e_duration + ( clock() - start ) / (double) CLOCKS_PER_SEC;
+		run.record(e_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
 
 		// Reset cipher object
 		cipher->clear();
@@ -105,15 +118,17 @@ int timeChaChaOp(string plaintext) {
 		// Decrypt
 		start = clock();
 		cipher->encipher(pt);
-		d_duration = d_duration + ( clock() - start ) / (double) CLOCKS_PER_SEC;
+		run.record(d_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
 
-		string str(pt.begin(), pt.end());
+		verify(sameBytes(pt.data(), pt.size(), plaintext.data(), plaintext.length()), "ChaCha round trip");
 	
 	}
 
-	cout << "Avg encryption time: " << e_duration/numTrials << endl;
-	cout << "Avg decryption time: " << d_duration/numTrials << endl;
+	run.report("Avg encryption time", e_time);
+	run.report("Avg decryption time", d_time);
+	run.finish();
 
+	return 0;
 }
 
 /*
@@ -123,19 +138,27 @@ int timeChaChaOp(string plaintext) {
  */
 int timeHashOp(string plaintext) {
 	clock_t start;
-	double duration;
+	RunController run;
+	Sample h_time;
 
-	for(int i=0; i<numTrials; i++) {
+	// One-shot reference digest each trial's result is checked against
+	const Botan::secure_vector<uint8_t> expected = Botan::HashFunction::create("SHA-256")->process(plaintext);
+
+	while(run.next()) {
 		// Initialize hash object
 		unique_ptr<Botan::HashFunction> hash1(Botan::HashFunction::create("SHA-256"));
 
 		start = clock();
 		hash1->update(plaintext);
-		duration = duration + ( clock() - start ) / (double) CLOCKS_PER_SEC;
-		
+		Botan::secure_vector<uint8_t> digest = hash1->final();
+		doNotOptimize(digest.data());
+		run.record(h_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		verify(digest == expected, "SHA256 digest");
 	}
 
-	cout << "Avg hash time: " << duration/numTrials << endl;
+	run.report("Avg hash time", h_time);
+	run.finish();
 	return 0;
 }
 
@@ -146,12 +169,13 @@ int timeHashOp(string plaintext) {
  */
 int timeRSAOp(string plaintext) {
 	clock_t start;
-	double e_duration=0, d_duration=0;
+	RunController run;
+	Sample e_time, d_time;
 
-	for(int i=0; i<numTrials; i++) {		
+	// Get RNG once; its seeding cost is measured separately by timeRNGOp
+	Botan::AutoSeeded_RNG rng;
 
-		// Get RNG
-		Botan::AutoSeeded_RNG rng;
+	while(run.next()) {		
 
 		// Generate new RSA private key
 		Botan::RSA_PrivateKey key(rng, 2048);
@@ -190,7 +214,7 @@ int timeRSAOp(string plaintext) {
 			vector<uint8_t> ct = enc.encrypt(it, rng);
 			ct_vector.push_back(ct);
 		}
-		e_duration = e_duration + ( clock() - start ) / (double) CLOCKS_PER_SEC;
+		run.record(e_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
 
 		// Instantiate decryption object
 		Botan::PK_Decryptor_EME dec(*kp, rng, "EME-PKCS1-v1_5");
@@ -202,18 +226,278 @@ int timeRSAOp(string plaintext) {
 			Botan::secure_vector<uint8_t> dt = dec.decrypt(it);
 			dt_vector.push_back(dt);
 		}
-		d_duration = d_duration + ( clock() - start ) / (double) CLOCKS_PER_SEC;
+		run.record(d_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		verify(dt_vector == pt_vector, "RSA round trip");
 
 	}
 
-	cout << "Avg encryption time: " << e_duration/numTrials << endl;
-	cout << "Avg decryption time: " << d_duration/numTrials << endl;
+	run.report("Avg encryption time", e_time);
+	run.report("Avg decryption time", d_time);
+	run.finish();
 
 	return 0;
 }
 
+// RNG with a name, constructed fresh by a factory
+struct RNGKind {
+	string name;
+	function<Botan::RandomNumberGenerator*()> create;
+};
+
+// Instances a service could keep per thread; ChaCha_RNG seeds itself from the system RNG on first use
+const vector<RNGKind> rngKinds = {
+	{ "AutoSeeded_RNG", []() -> Botan::RandomNumberGenerator* { return new Botan::AutoSeeded_RNG; } },
+	{ "ChaCha_RNG", []() -> Botan::RandomNumberGenerator* { return new Botan::ChaCha_RNG(Botan::system_rng()); } },
+};
+
+/*
+ * Measures random number generation
+ * Prints the cost of a fresh RNG, single-thread throughput per request size, and how nonce
+ * generation scales across threads with shared instances and with per-thread instances
+ */
+void timeRNGOp() {
+	clock_t start;
+
+	// Fresh instance: construction, seeding, and its first nonce
+	for(const RNGKind& kind : rngKinds) {
+		const int instances = 100;
+		RunController run;
+		Sample c_time;
+		uint8_t nonce[nonceSize];
+
+		while(run.next()) {
+			start = clock();
+			for(int i=0; i<instances; i++) {
+				unique_ptr<Botan::RandomNumberGenerator> rng(kind.create());
+				rng->randomize(nonce, sizeof(nonce));
+				doNotOptimize(nonce);
+			}
+			run.record(c_time, ( clock() - start ) / (double) CLOCKS_PER_SEC / instances);
+		}
+
+		run.report("Avg " + kind.name + " construction and seeding time", c_time);
+		run.finish();
+	}
+
+	// Single thread throughput, including the operating system RNG
+	vector<pair<string, Botan::RandomNumberGenerator*>> rngs;
+	for(const RNGKind& kind : rngKinds) {
+		rngs.push_back(make_pair(kind.name, kind.create()));
+	}
+	rngs.push_back(make_pair(string("System_RNG"), &Botan::system_rng()));
+
+	for(int size : randSizes) {
+		int calls = randCallsFor(size);
+		vector<uint8_t> buf(size);
+		RunController run;
+		vector<Sample> times(rngs.size());
+
+		while(run.next()) {
+			for(size_t r=0; r<rngs.size(); r++) {
+				start = clock();
+				for(int i=0; i<calls; i++) {
+					rngs[r].second->randomize(buf.data(), size);
+					doNotOptimize(buf.data());
+				}
+				run.record(times[r], ( clock() - start ) / (double) CLOCKS_PER_SEC);
+			}
+		}
+
+		for(size_t r=0; r<rngs.size(); r++) {
+			run.reportRate(rngs[r].first + " " + to_string(size) + " B", times[r], (double) calls * size / 1e6, "MB");
+		}
+		run.finish();
+	}
+
+	// Nonce generation across threads; wall time, since the threads run concurrently
+	// Shared stateful RNGs serialise callers on an internal mutex
+	vector<double> base;
+
+	for(int threads : threadCounts()) {
+		vector<pair<string, vector<Botan::RandomNumberGenerator*>>> modes;
+		modes.push_back(make_pair(string("Shared AutoSeeded_RNG"), vector<Botan::RandomNumberGenerator*>(threads, rngs[0].second)));
+		modes.push_back(make_pair(string("Shared System_RNG"), vector<Botan::RandomNumberGenerator*>(threads, &Botan::system_rng())));
+		for(const RNGKind& kind : rngKinds) {
+			vector<Botan::RandomNumberGenerator*> own;
+			for(int t=0; t<threads; t++) {
+				own.push_back(kind.create());
+			}
+			modes.push_back(make_pair("Per-thread " + kind.name, own));
+		}
+
+		RunController run;
+		vector<Sample> times(modes.size());
+
+		while(run.next()) {
+			for(size_t m=0; m<modes.size(); m++) {
+				const vector<Botan::RandomNumberGenerator*>& per_thread = modes[m].second;
+				run.record(times[m], timeParallel(threads, [&](int t) {
+					uint8_t nonce[nonceSize];
+					for(int i=0; i<nonceCallsPerThread; i++) {
+						per_thread[t]->randomize(nonce, sizeof(nonce));
+						doNotOptimize(nonce);
+					}
+				}));
+			}
+		}
+
+		double calls = (double) nonceCallsPerThread * threads;
+		for(size_t m=0; m<modes.size(); m++) {
+			double rate = calls / times[m].mean();
+			if(threads == 1) {
+				base.push_back(rate);
+			}
+			run.reportRate(modes[m].first + " nonces, " + to_string(threads) + " threads", times[m], calls, "calls");
+			cout << "  " << 100 * rate / (base[m] * threads) << "% of linear scaling" << endl;
+		}
+		run.finish();
+
+		// Per-thread instances were created for this thread count only
+		for(size_t m=2; m<modes.size(); m++) {
+			for(Botan::RandomNumberGenerator* rng : modes[m].second) {
+				delete rng;
+			}
+		}
+	}
+
+	for(size_t r=0; r<rngKinds.size(); r++) {
+		delete rngs[r].second;
+	}
+}
+
+/*
+ * Performs key derivation across the settings in kdfsweep.h
+ * Prints latency, logins per second per core and memory for each setting
+ */
+void timeKDFOp() {
+	const uint8_t *salt = (const uint8_t *) kdfSalt;
+	size_t salt_len = strlen(kdfSalt);
+	size_t pass_len = strlen(kdfPassword);
+	const int max_threads = kdfMaxThreads();
+	vector<vector<uint8_t>> keys(max_threads, vector<uint8_t>(kdfKeyLength));
+
+	// PasswordHash and KDF objects keep keyed state, so each thread gets its own
+	vector<unique_ptr<Botan::PasswordHash>> hashes(max_threads);
+
+	unique_ptr<Botan::PasswordHashFamily> pbkdf2(Botan::PasswordHashFamily::create("PBKDF2(SHA-256)"));
+	for(unsigned long iterations : pbkdf2Iterations) {
+		for(int t=0; t<max_threads; t++) {
+			hashes[t] = pbkdf2->from_params(iterations);
+		}
+		timeKDFSetting("PBKDF2-HMAC-SHA256 iterations=" + to_string(iterations), 0, 1, "logins", [&](int t) {
+			hashes[t]->derive_key(keys[t].data(), keys[t].size(), kdfPassword, pass_len, salt, salt_len);
+			doNotOptimize(keys[t].data());
+		});
+	}
+
+	unique_ptr<Botan::PasswordHashFamily> scrypt(Botan::PasswordHashFamily::create("Scrypt"));
+	for(const ScryptSetting& setting : scryptSettings) {
+		for(int t=0; t<max_threads; t++) {
+			hashes[t] = scrypt->from_params(setting.N, setting.r, setting.p);
+		}
+		string label = "scrypt N=" + to_string(setting.N) + " r=" + to_string(setting.r) + " p=" + to_string(setting.p);
+		timeKDFSetting(label, scryptMemoryKiB(setting), 1, "logins", [&](int t) {
+			hashes[t]->derive_key(keys[t].data(), keys[t].size(), kdfPassword, pass_len, salt, salt_len);
+			doNotOptimize(keys[t].data());
+		});
+	}
+
+	unique_ptr<Botan::PasswordHashFamily> argon2(Botan::PasswordHashFamily::create("Argon2id"));
+	for(const Argon2Setting& setting : argon2Settings) {
+		for(int t=0; t<max_threads; t++) {
+			hashes[t] = argon2->from_params(setting.memory_kib, setting.iterations, setting.lanes);
+		}
+		string label = "Argon2id m=" + to_string(setting.memory_kib) + " KiB t=" + to_string(setting.iterations)
+			+ " p=" + to_string(setting.lanes);
+		timeKDFSetting(label, setting.memory_kib, 1, "logins", [&](int t) {
+			hashes[t]->derive_key(keys[t].data(), keys[t].size(), kdfPassword, pass_len, salt, salt_len);
+			doNotOptimize(keys[t].data());
+		});
+	}
+
+	// HKDF is cheap, so each call performs a batch of derivations from the key derived above
+	const int batch = 1000;
+	const string info = "login session";
+	const vector<uint8_t>& key = keys[0];
+	vector<unique_ptr<Botan::KDF>> hkdfs;
+	for(int t=0; t<max_threads; t++) {
+		hkdfs.push_back(unique_ptr<Botan::KDF>(Botan::KDF::create("HKDF(SHA-256)")));
+	}
+	for(size_t length : hkdfLengths) {
+		timeKDFSetting("HKDF-SHA256 L=" + to_string(length), 0, batch, "derivations", [&](int t) {
+			for(int i=0; i<batch; i++) {
+				Botan::secure_vector<uint8_t> out = hkdfs[t]->derive_key(length, key.data(), key.size(), salt, salt_len,
+					(const uint8_t *) info.data(), info.size());
+				doNotOptimize(out.data());
+			}
+		});
+	}
+}
+
+/*
+ * Checks each primitive against published test vectors
+ * Exits if any result differs
+ */
+void runKnownAnswerTests() {
+	// AES-256 single block
+	unique_ptr<Botan::BlockCipher> aes(Botan::BlockCipher::create("AES-256"));
+	aes->set_key(Botan::hex_decode(aes256KatKey));
+	Botan::secure_vector<uint8_t> block = Botan::hex_decode_locked(aes256KatPlaintext);
+	aes->encrypt(block);
+	verify(block == Botan::hex_decode_locked(aes256KatCiphertext), "AES-256 known answer");
+
+	// ChaCha20 with a 96-bit nonce, starting at block counter 1
+	unique_ptr<Botan::StreamCipher> chacha(Botan::StreamCipher::create("ChaCha(20)"));
+	chacha->set_key(Botan::hex_decode(chachaKatKey));
+	vector<uint8_t> nonce = Botan::hex_decode(chachaKatNonce);
+	chacha->set_iv(nonce.data(), nonce.size());
+	chacha->seek(64);
+	Botan::secure_vector<uint8_t> stream(chachaKatPlaintext, chachaKatPlaintext + strlen(chachaKatPlaintext));
+	chacha->encipher(stream);
+	verify(stream == Botan::hex_decode_locked(chachaKatCiphertext), "ChaCha20 known answer");
+
+	// SHA256
+	unique_ptr<Botan::HashFunction> sha(Botan::HashFunction::create("SHA-256"));
+	sha->update(string(sha256KatMessage));
+	verify(sha->final() == Botan::hex_decode_locked(sha256KatDigest), "SHA256 known answer");
+
+	// Password hashes
+	vector<uint8_t> expected = Botan::hex_decode(pbkdf2KatKey);
+	vector<uint8_t> out(expected.size());
+	Botan::PasswordHashFamily::create("PBKDF2(SHA-256)")->from_params(pbkdf2KatIterations)->derive_key(
+		out.data(), out.size(), pbkdf2KatPassword, strlen(pbkdf2KatPassword),
+		(const uint8_t *) pbkdf2KatSalt, strlen(pbkdf2KatSalt));
+	verify(out == expected, "PBKDF2 known answer");
+
+	expected = Botan::hex_decode(scryptKatKey);
+	out.assign(expected.size(), 0);
+	Botan::PasswordHashFamily::create("Scrypt")->from_params(scryptKatN, scryptKatR, scryptKatP)->derive_key(
+		out.data(), out.size(), scryptKatPassword, strlen(scryptKatPassword),
+		(const uint8_t *) scryptKatSalt, strlen(scryptKatSalt));
+	verify(out == expected, "scrypt known answer");
+
+	expected = Botan::hex_decode(argon2idKatKey);
+	out.assign(expected.size(), 0);
+	Botan::PasswordHashFamily::create("Argon2id")->from_params(argon2idKatMemory, argon2idKatIterations, argon2idKatLanes)->derive_key(
+		out.data(), out.size(), argon2idKatPassword, strlen(argon2idKatPassword),
+		(const uint8_t *) argon2idKatSalt, strlen(argon2idKatSalt));
+	verify(out == expected, "Argon2id known answer");
+
+	// HKDF-SHA256
+	vector<uint8_t> ikm = Botan::hex_decode(hkdfKatKey);
+	vector<uint8_t> salt = Botan::hex_decode(hkdfKatSalt), info = Botan::hex_decode(hkdfKatInfo);
+	unique_ptr<Botan::KDF> hkdf(Botan::KDF::create("HKDF(SHA-256)"));
+	verify(hkdf->derive_key(strlen(hkdfKatOutput) / 2, ikm.data(), ikm.size(), salt.data(), salt.size(), info.data(), info.size())
+		== Botan::hex_decode_locked(hkdfKatOutput), "HKDF known answer");
+
+	cout << "Known-answer tests passed" << endl << endl;
+}
+
 int main() {
 
+	runKnownAnswerTests();
+
 	// Generate 5MB of just 'a's
 	string big_text(5242880, 'a');
 
@@ -239,6 +523,16 @@ int main() {
 	cout << "RSA Operations" << endl;
    	timeRSAOp(small_text);
 	cout << "=========================================================================" << endl << endl;
+
+	cout << "=========================================================================" << endl;
+	cout << "KDF Operations" << endl;
+   	timeKDFOp();
+	cout << "=========================================================================" << endl << endl;
+
+	cout << "=========================================================================" << endl;
+	cout << "RNG Operations" << endl;
+   	timeRNGOp();
+	cout << "=========================================================================" << endl << endl;
    
    return 0;
 }
\ No newline at end of file
@@ -0,0 +1,494 @@
+#include <botan/auto_rng.h>
+#include <botan/rsa.h>
+#include <botan/ecdsa.h>
+#include <botan/ec_group.h>
+#include <botan/x509self.h>
+#include <botan/x509_ca.h>
+#include <botan/certstor.h>
+#include <botan/credentials_manager.h>
+#include <botan/tls_client.h>
+#include <botan/tls_server.h>
+#include <botan/tls_callbacks.h>
+#include <botan/tls_policy.h>
+#include <botan/tls_session_manager.h>
+#include <iostream>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <stdexcept>
+#include <csignal>
+
+#include "runcontrol.h"
+#include "verify.h"
+#include "parallel.h"
+#include "tlsbench.h"
+
+using namespace std;
+
+// Error handler; prints the exception and exits program
+void handleErrors(const string& what, const exception& e) {
+	cout << "Something went wrong with " << what << ": " << e.what() << endl;
+	exit(EXIT_FAILURE);
+}
+
+/*
+ * Issues a certificate for localhost, signed by a new CA of the same key type
+ * Botan does not accept a self-signed certificate as a server certificate, so the chain has a root
+ * @key: server key
+ * @ca_key: key of the CA
+ * @ca_cert: set to the CA certificate, for the clients' trust store
+ * @rng: random number generator
+ */
+Botan::X509_Certificate issueCertificate(const Botan::Private_Key& key, const Botan::Private_Key& ca_key,
+	unique_ptr<Botan::X509_Certificate>& ca_cert, Botan::RandomNumberGenerator& rng) {
+	Botan::X509_Cert_Options ca_opts;
+	ca_opts.common_name = "Benchmark CA";
+	ca_opts.CA_key();
+	ca_cert.reset(new Botan::X509_Certificate(Botan::X509::create_self_signed_cert(ca_opts, ca_key, "SHA-256", rng)));
+
+	Botan::X509_Cert_Options opts;
+	opts.common_name = "localhost";
+	opts.dns = "localhost";
+	Botan::PKCS10_Request request = Botan::X509::create_cert_req(opts, key, "SHA-256", rng);
+
+	Botan::X509_CA ca(*ca_cert, ca_key, "SHA-256", rng);
+	auto now = chrono::system_clock::now();
+	return ca.sign_request(request, rng, Botan::X509_Time(now), Botan::X509_Time(now + chrono::hours(24)));
+}
+
+/*
+ * Settings of one benchmark run
+ */
+struct TLSConfig {
+	// Description for output
+	string name;
+	Botan::Private_Key *key;
+	const Botan::X509_Certificate *cert;
+	const Botan::X509_Certificate *ca_cert;
+	// Cipher to negotiate, as named by TLS::Policy; empty for the library default
+	string cipher;
+};
+
+/*
+ * Hands the server its certificate and key, and the client its trusted root
+ */
+class BenchCredentials : public Botan::Credentials_Manager {
+public:
+	explicit BenchCredentials(const TLSConfig& config) : config(config) {
+		trusted.add_certificate(*config.ca_cert);
+	}
+
+	// Only clients get a trust store; a server with one would ask for client certificates
+	vector<Botan::Certificate_Store*> trusted_certificate_authorities(const string& type, const string&) override {
+		if(type == "tls-client") {
+			return { &trusted };
+		}
+		return {};
+	}
+
+	vector<Botan::X509_Certificate> cert_chain(const vector<string>& cert_key_types, const string& type, const string&) override {
+		if(type == "tls-server" && find(cert_key_types.begin(), cert_key_types.end(), config.key->algo_name()) != cert_key_types.end()) {
+			return { *config.cert };
+		}
+		return {};
+	}
+
+	Botan::Private_Key* private_key_for(const Botan::X509_Certificate&, const string&, const string&) override {
+		return config.key;
+	}
+
+private:
+	const TLSConfig& config;
+	Botan::Certificate_Store_In_Memory trusted;
+};
+
+/*
+ * Restricts both sides to ECDHE key exchange and, for bulk runs, a single cipher
+ */
+class BenchPolicy : public Botan::TLS::Policy {
+public:
+	explicit BenchPolicy(const string& cipher) : cipher(cipher) {}
+
+	vector<string> allowed_ciphers() const override {
+		if(cipher.empty()) {
+			return Botan::TLS::Policy::allowed_ciphers();
+		}
+		return { cipher };
+	}
+
+	vector<string> allowed_key_exchange_methods() const override {
+		return { "ECDH" };
+	}
+
+private:
+	string cipher;
+};
+
+/*
+ * One side of a connection: writes TLS output to the socket and records what the channel reports
+ */
+class Endpoint : public Botan::TLS::Callbacks {
+public:
+	explicit Endpoint(int fd) : fd(fd), received(0), last_byte(0), closed(false), certificates_verified(0) {}
+
+	// Write errors are left for the reader to see as end of stream
+	void tls_emit_data(const uint8_t data[], size_t size) override {
+		while(size > 0) {
+			ssize_t len = send(fd, data, size, MSG_NOSIGNAL);
+			if(len <= 0) {
+				return;
+			}
+			data += len;
+			size -= len;
+		}
+	}
+
+	void tls_record_received(uint64_t, const uint8_t data[], size_t size) override {
+		received += size;
+		if(size > 0) {
+			last_byte = data[size - 1];
+		}
+	}
+
+	void tls_alert(Botan::TLS::Alert alert) override {
+		if(alert.type() == Botan::TLS::Alert::CLOSE_NOTIFY) {
+			closed = true;
+		}
+	}
+
+	bool tls_session_established(const Botan::TLS::Session& session) override {
+		cipher = session.ciphersuite().cipher_algo();
+		return true;
+	}
+
+	// Only called on full handshakes, which tells them apart from resumed ones
+	void tls_verify_cert_chain(const vector<Botan::X509_Certificate>& cert_chain,
+		const vector<shared_ptr<const Botan::OCSP::Response>>& ocsp_responses,
+		const vector<Botan::Certificate_Store*>& trusted_roots, Botan::Usage_Type usage,
+		const string& hostname, const Botan::TLS::Policy& policy) override {
+		certificates_verified++;
+		Botan::TLS::Callbacks::tls_verify_cert_chain(cert_chain, ocsp_responses, trusted_roots, usage, hostname, policy);
+	}
+
+	int fd;
+	size_t received;
+	uint8_t last_byte;
+	bool closed;
+	int certificates_verified;
+	string cipher;
+};
+
+/*
+ * Feeds socket data to a channel until a condition holds
+ * Returns false if the peer closed the socket first
+ * @endpoint: connection the channel writes to
+ * @channel: TLS client or server
+ * @done: condition to wait for
+ */
+template <typename Done>
+bool pump(Endpoint& endpoint, Botan::TLS::Channel& channel, Done done) {
+	vector<uint8_t> buf(recordSize);
+	while(!done()) {
+		ssize_t len = read(endpoint.fd, buf.data(), buf.size());
+		if(len <= 0) {
+			return false;
+		}
+		channel.received_data(buf.data(), len);
+	}
+	return true;
+}
+
+/*
+ * State of one run shared by every connection
+ * The server session cache is shared by all server threads; Session_Manager_In_Memory is thread safe
+ */
+struct TLSContext {
+	TLSContext(const TLSConfig& config, bool resume) : config(config), creds(config), policy(config.cipher) {
+		if(resume) {
+			sessions.reset(new Botan::TLS::Session_Manager_In_Memory(session_rng));
+		} else {
+			sessions.reset(new Botan::TLS::Session_Manager_Noop);
+		}
+	}
+
+	const TLSConfig& config;
+	BenchCredentials creds;
+	BenchPolicy policy;
+	Botan::AutoSeeded_RNG session_rng;
+	unique_ptr<Botan::TLS::Session_Manager> sessions;
+};
+
+/*
+ * Per-client state kept across trials
+ * Sessions are cached under the host name alone, since every trial listens on a new port
+ */
+struct ClientState {
+	explicit ClientState(bool resume) {
+		if(resume) {
+			sessions.reset(new Botan::TLS::Session_Manager_In_Memory(rng));
+		} else {
+			sessions.reset(new Botan::TLS::Session_Manager_Noop);
+		}
+	}
+
+	Botan::AutoSeeded_RNG rng;
+	unique_ptr<Botan::TLS::Session_Manager> sessions;
+};
+
+/*
+ * Serves one connection
+ * Completes the handshake, sends a byte so the client knows, then reads until the client closes,
+ * acknowledging each complete bulk transfer with another byte
+ * @ctx: shared state of the run
+ * @rng: random number generator of the server thread
+ * @fd: accepted socket
+ */
+void serveConnection(TLSContext& ctx, Botan::RandomNumberGenerator& rng, int fd) {
+	const uint8_t ack = 'k';
+	Endpoint endpoint(fd);
+	Botan::TLS::Server server(endpoint, *ctx.sessions, ctx.creds, ctx.policy, rng);
+
+	if(pump(endpoint, server, [&]() { return server.is_active(); })) {
+		server.send(&ack, 1);
+
+		// Botan answers the client's close_notify itself
+		while(pump(endpoint, server, [&]() { return endpoint.closed || endpoint.received >= bulkBytesPerConnection; })
+			&& !endpoint.closed) {
+			endpoint.received -= bulkBytesPerConnection;
+			server.send(&ack, 1);
+		}
+	}
+
+	close(fd);
+}
+
+/*
+ * An established client connection
+ */
+struct ClientConnection {
+	explicit ClientConnection(int fd) : endpoint(fd) {}
+
+	Endpoint endpoint;
+	unique_ptr<Botan::TLS::Client> channel;
+};
+
+/*
+ * Connects to the server and completes a handshake, up to the server's first byte
+ * Returns the established connection
+ * @ctx: shared state of the run
+ * @client: state of this client
+ * @port: server port
+ * @resume: expect to resume the cached session rather than do a full handshake
+ */
+unique_ptr<ClientConnection> clientConnect(TLSContext& ctx, ClientState& client, int port, bool resume) {
+	unique_ptr<ClientConnection> conn(new ClientConnection(connectLoopback(port)));
+	conn->channel.reset(new Botan::TLS::Client(conn->endpoint, *client.sessions, ctx.creds, ctx.policy, client.rng,
+		Botan::TLS::Server_Information("localhost"), Botan::TLS::Protocol_Version::TLS_V12));
+
+	if(!pump(conn->endpoint, *conn->channel, [&]() { return conn->endpoint.received > 0; }))
+		handleErrors("the TLS handshake", runtime_error("server closed the connection"));
+	verify(conn->endpoint.last_byte == 'k', "handshake acknowledgement");
+
+	verify(conn->endpoint.certificates_verified == (resume ? 0 : 1), resume ? "session resumption" : "full handshake");
+	verify(ctx.config.cipher.empty() || ctx.config.cipher == conn->endpoint.cipher, "negotiated cipher");
+	conn->endpoint.received = 0;
+	return conn;
+}
+
+// Closes a client connection cleanly
+void clientClose(unique_ptr<ClientConnection>& conn) {
+	conn->channel->close();
+	close(conn->endpoint.fd);
+	conn.reset();
+}
+
+/*
+ * Runs one loopback load trial
+ * Starts a server thread per connection, runs setup on every client, then times work on every client
+ * Returns the wall time of the work
+ * @ctx: shared state of the run
+ * @connections: number of concurrent connections
+ * @setup: untimed client preparation, taking the client index and server port
+ * @work: timed client work, taking the client index and server port
+ */
+template <typename Setup, typename Work>
+double runLoad(TLSContext& ctx, int connections, Setup setup, Work work) {
+	int port;
+	int listen_fd = listenLoopback(&port);
+
+	vector<thread> servers;
+	for(int t=0; t<connections; t++) {
+		servers.push_back(thread([&]() {
+			try {
+				Botan::AutoSeeded_RNG rng;
+				int fd;
+				while((fd = acceptLoopback(listen_fd)) >= 0) {
+					serveConnection(ctx, rng, fd);
+				}
+			} catch(const exception& e) {
+				handleErrors("the TLS server", e);
+			}
+		}));
+	}
+
+	timeParallel(connections, [&](int t) {
+		try {
+			setup(t, port);
+		} catch(const exception& e) {
+			handleErrors("the TLS client", e);
+		}
+	});
+	double seconds = timeParallel(connections, [&](int t) {
+		try {
+			work(t, port);
+		} catch(const exception& e) {
+			handleErrors("the TLS client", e);
+		}
+	});
+
+	closeListener(listen_fd);
+	for(thread& server : servers) {
+		server.join();
+	}
+	return seconds;
+}
+
+/*
+ * Performs repeated handshakes on concurrent connections
+ * Prints handshakes per second and the client-side latency histogram for each connection count
+ * Latency runs from TCP connect until the server's first application byte arrives
+ * @config: settings of the run
+ * @resume: resume the cached session instead of doing full handshakes
+ */
+void timeHandshakeOp(const TLSConfig& config, bool resume) {
+	string mode = resume ? " resumed" : " full";
+
+	for(int connections : connectionCounts) {
+		TLSContext ctx(config, resume);
+		RunController run;
+		Sample h_time;
+		LatencyHistogram latency;
+		vector<unique_ptr<ClientState>> clients;
+		vector<bool> primed(connections, false);
+		for(int t=0; t<connections; t++) {
+			clients.push_back(unique_ptr<ClientState>(new ClientState(resume)));
+		}
+
+		while(run.next()) {
+			vector<LatencyHistogram> per_client(connections);
+
+			double seconds = runLoad(ctx, connections, [&](int t, int port) {
+				// Resumed runs start from a session of an untimed full handshake
+				if(resume && !primed[t]) {
+					unique_ptr<ClientConnection> conn = clientConnect(ctx, *clients[t], port, false);
+					clientClose(conn);
+					primed[t] = true;
+				}
+			}, [&](int t, int port) {
+				for(int i=0; i<handshakesPerConnection; i++) {
+					double start = wallTime();
+					unique_ptr<ClientConnection> conn = clientConnect(ctx, *clients[t], port, resume);
+					per_client[t].add(wallTime() - start);
+					clientClose(conn);
+				}
+			});
+
+			run.record(h_time, seconds);
+			if(run.trials() > 0) {
+				for(const LatencyHistogram& client : per_client) {
+					latency.merge(client);
+				}
+			}
+		}
+
+		string label = config.name + mode + " handshakes, " + to_string(connections) + " connections";
+		run.reportRate(label, h_time, (double) connections * handshakesPerConnection, "handshakes");
+		latency.print(label);
+		run.finish();
+	}
+}
+
+/*
+ * Sends bulk application data on concurrent established connections
+ * Prints aggregate throughput for each connection count; handshakes are not timed
+ * @config: settings of the run, naming the cipher
+ */
+void timeBulkOp(const TLSConfig& config) {
+	vector<uint8_t> record(recordSize, 'a');
+
+	for(int connections : connectionCounts) {
+		TLSContext ctx(config, false);
+		RunController run;
+		Sample b_time;
+		vector<unique_ptr<ClientState>> clients;
+		for(int t=0; t<connections; t++) {
+			clients.push_back(unique_ptr<ClientState>(new ClientState(false)));
+		}
+
+		while(run.next()) {
+			vector<unique_ptr<ClientConnection>> conns(connections);
+
+			double seconds = runLoad(ctx, connections, [&](int t, int port) {
+				conns[t] = clientConnect(ctx, *clients[t], port, false);
+			}, [&](int t, int) {
+				ClientConnection& conn = *conns[t];
+				for(size_t sent=0; sent<bulkBytesPerConnection; sent+=recordSize) {
+					conn.channel->send(record.data(), record.size());
+				}
+
+				// Server acknowledges once it has read every byte
+				if(!pump(conn.endpoint, *conn.channel, [&]() { return conn.endpoint.received > 0; }))
+					handleErrors("the transfer", runtime_error("server closed the connection"));
+				verify(conn.endpoint.last_byte == 'k', "transfer acknowledgement");
+				clientClose(conns[t]);
+			});
+
+			run.record(b_time, seconds);
+		}
+
+		run.reportRate(config.name + " bulk, " + to_string(connections) + " connections", b_time,
+			(double) connections * bulkBytesPerConnection / 1e6, "MB");
+		run.finish();
+	}
+}
+
+int main() {
+	// A peer closing mid-write must surface as an error, not kill the process
+	signal(SIGPIPE, SIG_IGN);
+
+	Botan::AutoSeeded_RNG rng;
+	Botan::RSA_PrivateKey rsa_key(rng, 2048), rsa_ca_key(rng, 2048);
+	Botan::ECDSA_PrivateKey ec_key(rng, Botan::EC_Group("secp256r1")), ec_ca_key(rng, Botan::EC_Group("secp256r1"));
+	unique_ptr<Botan::X509_Certificate> rsa_ca_cert, ec_ca_cert;
+	Botan::X509_Certificate rsa_cert = issueCertificate(rsa_key, rsa_ca_key, rsa_ca_cert, rng);
+	Botan::X509_Certificate ec_cert = issueCertificate(ec_key, ec_ca_key, ec_ca_cert, rng);
+
+	// Botan 2 implements TLS up to 1.2
+	const TLSConfig handshakeConfigs[] = {
+		{ "TLS1.2 RSA-2048", &rsa_key, &rsa_cert, rsa_ca_cert.get(), "" },
+		{ "TLS1.2 ECDSA-P256", &ec_key, &ec_cert, ec_ca_cert.get(), "" },
+	};
+
+	const TLSConfig bulkConfigs[] = {
+		{ "TLS1.2 ECDHE-RSA AES-128/GCM", &rsa_key, &rsa_cert, rsa_ca_cert.get(), "AES-128/GCM" },
+		{ "TLS1.2 ECDHE-RSA AES-256/GCM", &rsa_key, &rsa_cert, rsa_ca_cert.get(), "AES-256/GCM" },
+		{ "TLS1.2 ECDHE-RSA ChaCha20Poly1305", &rsa_key, &rsa_cert, rsa_ca_cert.get(), "ChaCha20Poly1305" },
+	};
+
+	cout << "=========================================================================" << endl;
+	cout << "TLS Handshakes" << endl;
+	for(const TLSConfig& config : handshakeConfigs) {
+		timeHandshakeOp(config, false);
+		timeHandshakeOp(config, true);
+	}
+	cout << "=========================================================================" << endl << endl;
+
+	cout << "=========================================================================" << endl;
+	cout << "TLS Bulk Transfer" << endl;
+	for(const TLSConfig& config : bulkConfigs) {
+		timeBulkOp(config);
+	}
+	cout << "=========================================================================" << endl << endl;
+
+	return 0;
+}
@@ -0,0 +1,73 @@
+#ifndef FHEMATRIX_H
+#define FHEMATRIX_H
+
+#include <cstdio>
+
+/*
+ * Shared definitions for the FHE parameter matrix
+ * sealtest, helibtest and fhewtest each run the same workload at these targets when given --matrix:
+ * encrypt two operands, add them, multiply the sum by the second operand, decrypt
+ */
+
+// Plaintext operands of the matrix workload; result is (a + b) * b
+const int matrixOperandA = 7;
+const int matrixOperandB = 8;
+
+/*
+ * Security target and the parameters each library uses to meet it
+ * SEAL takes coeff_modulus from DefaultParams for the level, HElib picks m with FindM,
+ * FHEW parameters are fixed at compile time and cannot follow the target
+ */
+struct SecurityTarget {
+	// Target security level in bits
+	int bits;
+	// SEAL polynomial modulus degree, large enough for one multiplication at this level
+	unsigned long seal_poly_degree;
+	// Number of bits of the HElib modulus chain
+	unsigned long helib_bits;
+};
+
+const SecurityTarget securityTargets[] = {
+	{ 128, 4096, 300 },
+	{ 192, 8192, 300 },
+	{ 256, 8192, 300 },
+};
+
+const int numSecurityTargets = sizeof(securityTargets) / sizeof(securityTargets[0]);
+
+// Prints the column headings of the matrix
+inline void printMatrixHeader() {
+	printf("%-8s %-7s %-8s %-10s %-28s %-12s %-12s %-12s %-12s %s\n",
+		"Library", "Scheme", "Target", "Estimated", "Parameters", "Encrypt", "Add", "Multiply", "Decrypt", "Stability");
+}
+
+/*
+ * Prints one row of the matrix; times are averages per operation in seconds
+ * @library: library name
+ * @scheme: FHE scheme
+ * @target: target security level in bits, or 0 if the parameters are fixed
+ * @estimated: library's own security estimate in bits, or 0 if it has none
+ * @params: short description of the chosen parameters
+ * @stability: confidence interval and markers from RunController::stability()
+ */
+inline void printMatrixRow(const char* library, const char* scheme, int target, double estimated, const char* params,
+		double e_time, double a_time, double m_time, double d_time, const char* stability) {
+	char target_str[16], estimated_str[16];
+
+	if(target > 0) {
+		snprintf(target_str, sizeof(target_str), "%d", target);
+	} else {
+		snprintf(target_str, sizeof(target_str), "fixed");
+	}
+
+	if(estimated > 0) {
+		snprintf(estimated_str, sizeof(estimated_str), "%.1f", estimated);
+	} else {
+		snprintf(estimated_str, sizeof(estimated_str), "-");
+	}
+
+	printf("%-8s %-7s %-8s %-10s %-28s %-12.4g %-12.4g %-12.4g %-12.4g %s\n",
+		library, scheme, target_str, estimated_str, params, e_time, a_time, m_time, d_time, stability);
+}
+
+#endif
@@ -1,13 +1,149 @@
 #include <iostream>
 #include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "FHEW/LWE.h"
 #include "FHEW/FHEW.h"
 #include "FHEW/distrib.h"
+#include "fhematrix.h"
+#include "runcontrol.h"
+#include "verify.h"
 
-const int numTrials = 5;
+// Identifies key files written by saveKeys(); bump the digit if the layout changes
+const char keyFileMagic[8] = {'F','H','E','W','K','E','Y','1'};
+
+// Sections of the key file start on this boundary so they can be mapped in place
+const size_t keyFileAlign = 4096;
 
 using namespace std;
 
+/*
+ * Key file header
+ * The secret key, bootstrapping key and switching key follow as raw in-memory images,
+ * so the file is only valid for an FHEW build with the same parameters
+ */
+struct KeyFileHeader {
+	char magic[8];
+	size_t n;
+	size_t N;
+	size_t sk_offset, sk_size;
+	size_t bs_offset, bs_size;
+	size_t ks_offset, ks_size;
+};
+
+// Rounds offset up to the next section boundary
+size_t alignOffset(size_t offset) {
+	return (offset + keyFileAlign - 1) / keyFileAlign * keyFileAlign;
+}
+
+// Fills in the parameters and section layout of a key file for this FHEW build
+void layoutKeyFile(KeyFileHeader* header) {
+	memset(header, 0, sizeof(*header));
+	memcpy(header->magic, keyFileMagic, sizeof(header->magic));
+	header->n = n;
+	header->N = N;
+	header->sk_size = sizeof(LWE::SecretKey);
+	header->bs_size = sizeof(FHEW::BootstrappingKey);
+	header->ks_size = sizeof(LWE::SwitchingKey);
+	header->sk_offset = alignOffset(sizeof(*header));
+	header->bs_offset = alignOffset(header->sk_offset + header->sk_size);
+	header->ks_offset = alignOffset(header->bs_offset + header->bs_size);
+}
+
+/*
+ * Saves the secret key and evaluation key to a binary key file
+ * Returns size of the written file in bytes
+ * @path: file to write
+ * @LWEsk: secret key used for encryption
+ * @EK: evaluation key for homomorphic operations
+ */
+size_t saveKeys(const char* path, const LWE::SecretKey LWEsk, const FHEW::EvalKey& EK) {
+	KeyFileHeader header;
+	layoutKeyFile(&header);
+
+	FILE* f = fopen(path, "wb");
+	if(f == NULL) {
+		cout << "Could not open key file " << path << " for writing." << endl;
+		exit(EXIT_FAILURE);
+	}
+
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+		&& fseek(f, header.sk_offset, SEEK_SET) == 0
+		&& fwrite(LWEsk, header.sk_size, 1, f) == 1
+		&& fseek(f, header.bs_offset, SEEK_SET) == 0
+		&& fwrite(EK.BSkey, header.bs_size, 1, f) == 1
+		&& fseek(f, header.ks_offset, SEEK_SET) == 0
+		&& fwrite(EK.KSkey, header.ks_size, 1, f) == 1;
+
+	if(fclose(f) != 0 || !ok) {
+		cout << "Something went wrong writing key file " << path << "." << endl;
+		exit(EXIT_FAILURE);
+	}
+
+	return header.ks_offset + header.ks_size;
+}
+
+/*
+ * Maps a key file written by saveKeys() into memory
+ * The evaluation key points straight into the read-only mapping, which stays valid until exit
+ * Returns size of the mapped file in bytes, or 0 if the file does not exist
+ * @path: file to read
+ * @LWEsk: secret key to fill in
+ * @EK: evaluation key to fill in
+ */
+size_t loadKeys(const char* path, LWE::SecretKey LWEsk, FHEW::EvalKey* EK) {
+	int fd = open(path, O_RDONLY);
+	if(fd < 0) {
+		return 0;
+	}
+
+	struct stat st;
+	if(fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(KeyFileHeader)) {
+		cout << "Key file " << path << " is truncated." << endl;
+		exit(EXIT_FAILURE);
+	}
+	size_t size = st.st_size;
+
+	// Populate the page tables up front so load time includes reading the key
+	void* base = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+	close(fd);
+	if(base == MAP_FAILED) {
+		cout << "Could not map key file " << path << "." << endl;
+		exit(EXIT_FAILURE);
+	}
+
+	const char* bytes = (const char*) base;
+	const KeyFileHeader* header = (const KeyFileHeader*) bytes;
+
+	// Every field must match the layout saveKeys() would write, so no offset can point outside the mapping
+	KeyFileHeader expected;
+	layoutKeyFile(&expected);
+
+	if(memcmp(header->magic, expected.magic, sizeof(expected.magic)) != 0
+		|| header->n != expected.n || header->N != expected.N
+		|| header->sk_offset != expected.sk_offset || header->sk_size != expected.sk_size
+		|| header->bs_offset != expected.bs_offset || header->bs_size != expected.bs_size
+		|| header->ks_offset != expected.ks_offset || header->ks_size != expected.ks_size) {
+		cout << "Key file " << path << " was written with different FHEW parameters." << endl;
+		exit(EXIT_FAILURE);
+	}
+	if(expected.ks_offset + expected.ks_size > size) {
+		cout << "Key file " << path << " is truncated." << endl;
+		exit(EXIT_FAILURE);
+	}
+
+	memcpy(LWEsk, bytes + header->sk_offset, header->sk_size);
+	EK->BSkey = (FHEW::BootstrappingKey*) (bytes + header->bs_offset);
+	EK->KSkey = (LWE::SwitchingKey*) (bytes + header->ks_offset);
+
+	return size;
+}
+
 /*
  * Homomorphic XOR
  * A xor B = (A or B) and ~(A and B)
@@ -36,10 +172,74 @@ void HomXOR(LWE::CipherText* res, const FHEW::EvalKey& EK, const LWE::CipherText
 	FHEW::HomGate(res, and_g, EK, C, D);
 }
 
-int main() {
+/*
+ * Runs the matrix workload on the lowest bit of each operand
+ * FHEW parameters are fixed at compile time, so a single row is printed for all targets;
+ * addition is a homomorphic XOR and multiplication a homomorphic AND
+ * @EK: evaluation key for homomorphic operations
+ * @LWEsk: secret key used for encryption
+ */
+void timeMatrixOp(const FHEW::EvalKey& EK, const LWE::SecretKey LWEsk) {
+	clock_t start;
+	RunController run;
+	Sample e_time, a_time, m_time, d_time;
+
+	BinGate and_g = static_cast<BinGate>(AND);
+
+	while(run.next()) {
+		LWE::CipherText a, b, sum, product;
+
+		start = clock();
+		LWE::Encrypt(&a, LWEsk, matrixOperandA & 1);
+		run.record(e_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		start = clock();
+		LWE::Encrypt(&b, LWEsk, matrixOperandB & 1);
+		run.record(e_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		start = clock();
+		HomXOR(&sum, EK, a, b);
+		run.record(a_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		start = clock();
+		FHEW::HomGate(&product, and_g, EK, sum, b);
+		run.record(m_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		start = clock();
+		int result = LWE::Decrypt(LWEsk, product);
+		run.record(d_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		int a_bit = matrixOperandA & 1, b_bit = matrixOperandB & 1;
+		verify(result == ((a_bit ^ b_bit) & b_bit), "FHEW matrix workload");
+	}
+
+	char params[64];
+	snprintf(params, sizeof(params), "n=%d N=%d, per bit", n, N);
+
+	printMatrixHeader();
+	printMatrixRow("FHEW", "LWE", 0, 0, params,
+		e_time.mean(), a_time.mean(), m_time.mean(), d_time.mean(), run.stability().c_str());
+	run.finish();
+}
+
+/*
+ * Usage: fhewtest [--matrix] [keyfile]
+ * With a key file, keys are loaded from it if it exists, otherwise generated and saved to it
+ * --matrix runs the cross-library parameter matrix workload instead of the 32-bit adder
+ */
+int main(int argc, char *argv[]) {
 	clock_t start;
-	double add_duration, e_duration, d_duration;
 	double temp_duration;
+	const char* key_path = NULL;
+	bool matrix = false;
+
+	for(int i=1; i<argc; i++) {
+		if(strcmp(argv[i], "--matrix") == 0) {
+			matrix = true;
+		} else {
+			key_path = argv[i];
+		}
+	}
 
 	cout << "=========================================================================" << endl;
 	cout << "FHEW \n";
@@ -48,17 +248,49 @@ int main() {
 	
 	// Key used for encryption
 	LWE::SecretKey LWEsk;
-	LWE::KeyGen(LWEsk);
 
 	// Key for performing functions
 	FHEW::EvalKey EK;
-	FHEW::KeyGen(&EK, LWEsk);
+
+	size_t key_size = 0;
+	if(key_path != NULL) {
+		// Wall time, since a cold load mostly waits on disk reads that CPU time does not count
+		double load_start = wallTime();
+		key_size = loadKeys(key_path, LWEsk, &EK);
+		if(key_size != 0) {
+			cout << "Key load time: " << wallTime() - load_start << endl;
+		}
+	}
+
+	if(key_size == 0) {
+		// Same clock as the key load time, so the two cold-start costs compare directly
+		double keygen_start = wallTime();
+		LWE::KeyGen(LWEsk);
+		FHEW::KeyGen(&EK, LWEsk);
+		cout << "Keygen time: " << wallTime() - keygen_start << endl;
+
+		if(key_path != NULL) {
+			key_size = saveKeys(key_path, LWEsk, EK);
+		} else {
+			key_size = sizeof(LWE::SecretKey) + sizeof(FHEW::BootstrappingKey) + sizeof(LWE::SwitchingKey);
+		}
+	}
+	cout << "Key size: " << key_size << " bytes" << endl;
+
+	if(matrix) {
+		timeMatrixOp(EK, LWEsk);
+		cout << "=========================================================================" << endl << endl;
+		return 0;
+	}
 
 	// Constants for binary gates
 	BinGate or_g = static_cast<BinGate>(OR);
 	BinGate and_g = static_cast<BinGate>(AND);
 
-	for(int i=0; i<numTrials; i++) {
+	RunController run;
+	Sample e_time, add_time, d_time;
+
+	while(run.next()) {
 
 		// Encrypt operand b'101
 		int a_pt1 = 1;
@@ -73,7 +305,7 @@ int main() {
 		temp_duration = ( clock() - start ) / (double) CLOCKS_PER_SEC;
 		// Extrapolate to get time taken for encrypting 32-bits
 		temp_duration = (temp_duration/3)*32;
-		e_duration += temp_duration;
+		run.record(e_time, temp_duration);
 
 
 		// Encrypt operand b'010'
@@ -89,7 +321,7 @@ int main() {
 		temp_duration = ( clock() - start ) / (double) CLOCKS_PER_SEC;
 		// Extrapolate to get time taken for encrypting 32-bits
 		temp_duration = (temp_duration/3)*32;
-		e_duration += temp_duration;
+		run.record(e_time, temp_duration);
 
 
 		int dummy1 = 0;
@@ -123,7 +355,8 @@ int main() {
 
 			FHEW::HomGate(&dummyRes, and_g, EK, dummyCT1, dummyCT2);
 		}
-		add_duration = add_duration + ( clock() - start ) / (double) CLOCKS_PER_SEC;
+		sink(dummyRes);
+		run.record(add_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
 
 
 		// Decrypt plaintext
@@ -134,14 +367,18 @@ int main() {
 		temp_duration = ( clock() - start ) / (double) CLOCKS_PER_SEC;
 		// Extrapolate to get time taken for encrypting 32-bits
 		temp_duration = (temp_duration/3)*32;
-		d_duration += temp_duration;
+		run.record(d_time, temp_duration);
+
+		// Sum bits are a XOR b, b'101 xor b'010 = b'111
+		verify(dt_1 == (a_pt1 ^ b_pt1) && dt_2 == (a_pt2 ^ b_pt2) && dt_3 == (a_pt3 ^ b_pt3), "FHEW XOR result");
 
 	}
 
-	// Divide by 10 because encrypting 2 numbers 5 times each
-	cout << "Avg encryption time: " << e_duration/(numTrials*2) << endl;
-	cout << "Avg decryption time: " << d_duration/numTrials << endl;
-	cout << "Avg addition time: " << add_duration/numTrials << endl;
+	// Two 32-bit encryptions are recorded per trial, so this is the average of a single one
+	run.report("Avg encryption time", e_time);
+	run.report("Avg decryption time", d_time);
+	run.report("Avg addition time", add_time);
+	run.finish();
 
 	cout << "=========================================================================" << endl << endl;
 }
@@ -1,83 +1,230 @@
 #include <iostream>
+#include <vector>
+#include <ctime>
+#include <cstring>
+#include <string>
 
 #include <helib/FHE.h>
 #include <helib/EncryptedArray.h>
 
-int main(int argc, char *argv[]) {
-	/*  Using the BGV scheme  */
-
+#include "fhematrix.h"
+#include "runcontrol.h"
+#include "verify.h"
+
+/*
+ * BGV parameter set
+ * m is chosen by FindM so that the context meets the security target with the given chain
+ */
+struct BGVParams {
+	// Target security level in bits
+	long security;
 	// Plaintext prime modulus
-	unsigned long p = 5;
-	// Cyclotomic polynomial - defines phi(m)
-	unsigned long m = 2;
+	unsigned long p;
 	// Hensel lifting (default = 1)
-	unsigned long r = 1;
+	unsigned long r;
 	// Number of bits of the modulus chain
-	unsigned long bits = 3;
+	unsigned long bits;
 	// Number of columns of Key-Switching matix (default = 2 or 3)
-	unsigned long c = 2;
+	unsigned long c;
+};
+
+const BGVParams paramSets[] = {
+	{ 80, 2, 1, 300, 3 },
+	{ 128, 2, 1, 300, 3 },
+	{ 80, 257, 1, 500, 3 },
+	{ 128, 257, 1, 500, 3 },
+};
+
+/*
+ * Performs BGV key generation, encryption, multiplication, addition, rotation and decryption
+ * Prints time taken for operations to complete, total and amortised per slot
+ * @params: BGV parameter set to benchmark
+ */
+int timeBGVOp(const BGVParams& params) {
+	clock_t start;
+	Sample e_time, mul_time, add_time, rot_time, d_time;
+
+	// Cyclotomic polynomial - defines phi(m)
+	unsigned long m = FindM(params.security, params.bits, params.c, params.p, 0, 0, 0);
 
-	std::cout << "Initialising context object..." << std::endl;
 	// Intialise context
-	FHEcontext context(m, p, r);
+	FHEcontext context(m, params.p, params.r);
 	// Modify the context, adding primes to the modulus chain
-	std::cout  << "Building modulus chain..." << std::endl;
-	buildModChain(context, bits, c);
+	buildModChain(context, params.bits, params.c);
 
-	// Print the context
-	context.zMStar.printout();
-	std::cout << std::endl;
+	// Get the EncryptedArray of the context
+	const EncryptedArray& ea = *(context.ea);
+	long nslots = ea.size();
 
-	// Print the security level
+	std::cout << "m: " << m << ", phi(m): " << context.zMStar.getPhiM()
+		<< ", p: " << params.p << ", bits: " << params.bits << ", slots: " << nslots << std::endl;
 	std::cout << "Security: " << context.securityLevel() << std::endl;
 
-	// Secret key management
-	std::cout << "Creating secret key..." << std::endl;
 	// Create a secret key associated with the context
 	FHESecKey secret_key(context);
-	// Generate the secret key
+
+	// Time secret key generation
+	start = clock();
 	secret_key.GenSecKey();
-	std::cout << "Generating key-switching matrices..." << std::endl;
-	// Compute key-switching matrices that we need
+	std::cout << "Secret key generation time: " << ( clock() - start ) / (double) CLOCKS_PER_SEC << std::endl;
+
+	// Time generation of the key-switching matrices needed for multiplication and rotation
+	start = clock();
 	addSome1DMatrices(secret_key);
+	std::cout << "Key-switching matrix generation time: " << ( clock() - start ) / (double) CLOCKS_PER_SEC << std::endl;
 
-	// Public key management
 	// Set the secret key (upcast: FHESecKey is a subclass of FHEPubKey)
 	const FHEPubKey& public_key = secret_key;
 
-	// Get the EncryptedArray of the context
-	const EncryptedArray& ea = *(context.ea);
+	RunController run;
+
+	// Fill every slot with numbers 0..nslots - 1
+	std::vector<long> ptxt(nslots);
+	for (long i = 0; i < nslots; ++i) {
+		ptxt[i] = i % params.p;
+	}
+
+	while(run.next()) {
+
+		Ctxt ctxt1(public_key), ctxt2(public_key);
+
+		// Encrypt
+		start = clock();
+		ea.encrypt(ctxt1, public_key, ptxt);
+		run.record(e_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		ea.encrypt(ctxt2, public_key, ptxt);
+
+		// Multiply, including relinearisation
+		start = clock();
+		ctxt1.multiplyBy(ctxt2);
+		run.record(mul_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		// Add
+		start = clock();
+		ctxt1 += ctxt2;
+		run.record(add_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		// Rotate slots by one
+		start = clock();
+		ea.rotate(ctxt1, 1);
+		run.record(rot_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		// Decrypt
+		std::vector<long> decrypted(nslots);
+		start = clock();
+		ea.decrypt(ctxt1, secret_key, decrypted);
+		run.record(d_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
 
-	// Get the number of slot (phi(m))
+		// Slot j moved to j + 1 after holding x^2 + x
+		for (long j = 0; j < nslots; ++j) {
+			long x = ptxt[j];
+			verify(decrypted[(j + 1) % nslots] == (x * x + x) % (long) params.p, "BGV slot result");
+		}
+
+	}
+
+	run.report("Avg encryption time", e_time);
+	run.report("Avg multiplication time", mul_time);
+	run.report("Avg addition time", add_time);
+	run.report("Avg rotation time", rot_time);
+	run.report("Avg decryption time", d_time);
+
+	// Amortised over the slots each ciphertext packs
+	run.reportRate("Per slot encryption", e_time, nslots, "slots");
+	run.reportRate("Per slot multiplication", mul_time, nslots, "slots");
+	run.reportRate("Per slot addition", add_time, nslots, "slots");
+	run.reportRate("Per slot rotation", rot_time, nslots, "slots");
+	run.reportRate("Per slot decryption", d_time, nslots, "slots");
+	run.finish();
+
+	return 0;
+}
+
+/*
+ * Runs the matrix workload with BGV at a security target
+ * Prints a matrix row with the average time of each operation, per ciphertext
+ * @target: security target
+ */
+void timeBGVMatrixOp(const SecurityTarget& target) {
+	clock_t start;
+	RunController run;
+	Sample e_time, a_time, m_time, d_time;
+
+	// Plaintext prime large enough to hold the workload result without wrapping
+	unsigned long p = 257;
+	unsigned long c = 3;
+	unsigned long m = FindM(target.bits, target.helib_bits, c, p, 0, 0, 0);
+
+	FHEcontext context(m, p, 1);
+	buildModChain(context, target.helib_bits, c);
+	const EncryptedArray& ea = *(context.ea);
 	long nslots = ea.size();
-	std::cout << "Number of slots: " << nslots << std::endl;
 
-	// Create a vector of long with nslots elements
-	std::vector<long> ptxt(nslots);
-	// Set it with numbers 0..nslots - 1
-	for (int i = 0; i < nslots; ++i) {
-		ptxt[i] = i;
+	FHESecKey secret_key(context);
+	secret_key.GenSecKey();
+	addSome1DMatrices(secret_key);
+	const FHEPubKey& public_key = secret_key;
+
+	std::vector<long> ptxt1(nslots, matrixOperandA), ptxt2(nslots, matrixOperandB);
+
+	while(run.next()) {
+		Ctxt ctxt1(public_key), ctxt2(public_key);
+
+		start = clock();
+		ea.encrypt(ctxt1, public_key, ptxt1);
+		run.record(e_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		start = clock();
+		ea.encrypt(ctxt2, public_key, ptxt2);
+		run.record(e_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		start = clock();
+		ctxt1 += ctxt2;
+		run.record(a_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		// Multiplication includes relinearisation
+		start = clock();
+		ctxt1.multiplyBy(ctxt2);
+		run.record(m_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		std::vector<long> decrypted(nslots);
+		start = clock();
+		ea.decrypt(ctxt1, secret_key, decrypted);
+		run.record(d_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		for (long j = 0; j < nslots; ++j) {
+			verify(decrypted[j] == (matrixOperandA + matrixOperandB) * matrixOperandB % (long) p, "BGV matrix workload");
+		}
 	}
-	// Print the plaintext
-	std::cout << "Initial Ptxt: " << ptxt << std::endl;
 
-	// Create a ciphertext
-	Ctxt ctxt(public_key);
-	// Encrypt the plaintext using the public_key
-	ea.encrypt(ctxt, public_key, ptxt);
+	std::string params = "m=" + std::to_string(m) + " bits=" + std::to_string(target.helib_bits);
+	printMatrixRow("HElib", "BGV", target.bits, context.securityLevel(), params.c_str(),
+		e_time.mean(), a_time.mean(), m_time.mean(), d_time.mean(), run.stability().c_str());
+	run.finish();
+}
 
-	// Square the ciphertext
-	ctxt *= ctxt;
-	// Double it (using additions)
-	ctxt += ctxt;
+/*
+ * Usage: helibtest [--matrix]
+ * --matrix runs the cross-library parameter matrix instead of the BGV parameter sets
+ */
+int main(int argc, char *argv[]) {
 
-	// Create a plaintext for decryption
-	std::vector<long> decrypted(nslots);
-	// Decrypt the modified ciphertext
-	ea.decrypt(ctxt, secret_key, decrypted);
+	if(argc > 1 && strcmp(argv[1], "--matrix") == 0) {
+		RunController::checkHostOnce();
+		printMatrixHeader();
+		for(int i=0; i<numSecurityTargets; i++) {
+			timeBGVMatrixOp(securityTargets[i]);
+		}
+		return 0;
+	}
 
-	// Print the decrypted plaintext
-	std::cout << "Decrypted Ptxt: " << decrypted << std::endl;
+	for(const BGVParams& params : paramSets) {
+		std::cout << "=========================================================================" << std::endl;
+		std::cout << "BGV using HElib, " << params.security << "-bit security target" << std::endl;
+		timeBGVOp(params);
+		std::cout << "=========================================================================" << std::endl << std::endl;
+	}
 
 	return 0;
-}	
\ No newline at end of file
+}
@@ -0,0 +1,174 @@
+#ifndef KDFSWEEP_H
+#define KDFSWEEP_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <algorithm>
+#include <thread>
+#include <ctime>
+#include <cstdlib>
+#include <malloc.h>
+
+#include "runcontrol.h"
+#include "parallel.h"
+
+/*
+ * Key-derivation settings shared by openssltest and botantest, so both libraries sweep the same points
+ * Memory costs are in KiB, the unit Argon2 uses
+ */
+
+// Login being derived
+const char kdfPassword[] = "correct horse battery staple";
+const char kdfSalt[] = "0123456789abcdef";
+const size_t kdfKeyLength = 32;
+
+// PBKDF2-HMAC-SHA256 iteration counts
+const unsigned long pbkdf2Iterations[] = { 1000, 10000, 100000, 600000 };
+
+// scrypt cost parameters
+struct ScryptSetting {
+	unsigned long N;
+	unsigned long r;
+	unsigned long p;
+};
+
+const ScryptSetting scryptSettings[] = {
+	{ 1 << 14, 8, 1 },
+	{ 1 << 15, 8, 1 },
+	{ 1 << 16, 8, 1 },
+	{ 1 << 17, 8, 1 },
+	{ 1 << 15, 8, 2 },
+	{ 1 << 15, 8, 4 },
+};
+
+// Argon2id cost parameters
+struct Argon2Setting {
+	unsigned long memory_kib;
+	unsigned long iterations;
+	unsigned long lanes;
+};
+
+const Argon2Setting argon2Settings[] = {
+	{ 19456, 2, 1 },
+	{ 47104, 1, 1 },
+	{ 65536, 3, 1 },
+	{ 65536, 3, 4 },
+	{ 262144, 3, 4 },
+};
+
+// HKDF-SHA256 output lengths, up to the maximum of 255 hash blocks
+const size_t hkdfLengths[] = { 32, 256, 8160 };
+
+// Memory scrypt allocates: the 128*r*N byte table plus 128*r*p bytes of state
+inline double scryptMemoryKiB(const ScryptSetting& setting) {
+	return 128.0 * setting.r * (setting.N + setting.p) / 1024;
+}
+
+// Reads a "Name: value kB" field of a procfs file such as /proc/self/status, 0 if it is absent
+inline long procFieldKiB(const char* path, const std::string& field) {
+	std::ifstream in(path);
+	std::string line;
+	while(std::getline(in, line)) {
+		if(line.compare(0, field.size() + 1, field + ":") == 0) {
+			return atol(line.c_str() + field.size() + 1);
+		}
+	}
+	return 0;
+}
+
+/*
+ * Starts a peak RSS measurement of its own, so earlier settings do not show up in later ones
+ * Hands freed heap back to the kernel, then resets the kernel's high-water mark to the current RSS
+ * Returns the RSS the measurement starts from, or -1 if the kernel does not allow the reset
+ */
+inline long resetPeakRSS() {
+	malloc_trim(0);
+	std::ofstream clear_refs("/proc/self/clear_refs");
+	clear_refs << "5" << std::flush;
+	if(!clear_refs) {
+		return -1;
+	}
+	return procFieldKiB("/proc/self/status", "VmRSS");
+}
+
+// Peak RSS since the last resetPeakRSS()
+inline long peakRSSKiB() {
+	return procFieldKiB("/proc/self/status", "VmHWM");
+}
+
+// Per-thread state callers allocate for the concurrent runs: one per hardware thread
+inline int kdfMaxThreads() {
+	int threads = std::thread::hardware_concurrency();
+	return threads > 0 ? threads : 1;
+}
+
+/*
+ * Threads for the concurrent run of a setting: one per hardware thread, fewer if their combined
+ * memory would not fit in half of the available RAM
+ * @memory_kib: memory one derivation is defined to use
+ */
+inline int kdfThreads(double memory_kib) {
+	int threads = kdfMaxThreads();
+	long available = procFieldKiB("/proc/meminfo", "MemAvailable");
+	if(memory_kib > 0 && available > 0) {
+		threads = std::max(1, std::min(threads, (int) (available / 2 / memory_kib)));
+	}
+	return threads;
+}
+
+/*
+ * Times one KDF setting
+ * Prints wall-clock latency and derivations per second per core from CPU time on one thread, then
+ * the per-core rate with a derivation running on every hardware thread at once, where memory-hard
+ * settings contend for caches and memory bandwidth; then the peak RSS growth of each run
+ * @label: setting description
+ * @memory_kib: memory the setting is defined to use
+ * @ops: derivations performed by each call of derive
+ * @unit: what one derivation stands for, such as logins
+ * @derive: callable performing the derivations, taking a thread index below kdfMaxThreads();
+ *          calls with different indices run concurrently
+ */
+template <typename Derive>
+void timeKDFSetting(const std::string& label, double memory_kib, int ops, const std::string& unit, Derive derive) {
+	RunController run;
+	Sample wall_time, cpu_time;
+
+	long single_base = resetPeakRSS();
+	while(run.next()) {
+		double wall_start = wallTime();
+		clock_t start = clock();
+		derive(0);
+		run.record(cpu_time, ( clock() - start ) / (double) CLOCKS_PER_SEC / ops);
+		run.record(wall_time, ( wallTime() - wall_start ) / ops);
+	}
+	long single_peak = peakRSSKiB();
+
+	run.report(label + " latency", wall_time);
+	run.reportRate(label + " " + unit + "/s per core, single-thread", cpu_time, 1, unit);
+	run.finish();
+
+	int threads = kdfThreads(memory_kib);
+	RunController concurrent;
+	Sample parallel_time;
+
+	long parallel_base = resetPeakRSS();
+	while(concurrent.next()) {
+		concurrent.record(parallel_time, timeParallel(threads, derive));
+	}
+	long parallel_peak = peakRSSKiB();
+
+	// Each thread performs ops derivations, so the aggregate rate per thread is ops over the wall time
+	concurrent.reportRate(label + " " + unit + "/s per core, " + std::to_string(threads) + " threads", parallel_time, ops, unit);
+	concurrent.finish();
+
+	std::cout << label << " memory: " << memory_kib << " KiB defined, ";
+	if(single_base < 0 || parallel_base < 0) {
+		std::cout << "peak RSS unavailable" << std::endl;
+	} else {
+		std::cout << "peak RSS growth " << single_peak - single_base << " KiB single-thread, "
+			<< parallel_peak - parallel_base << " KiB with " << threads << " threads" << std::endl;
+	}
+}
+
+#endif
@@ -1,15 +1,29 @@
 #include <sstream>
 #include <iostream>
+#include <vector>
 #include <cstring>
 #include <ctime>
+#include <mutex>
 
 #include <openssl/conf.h>
 #include <openssl/evp.h>
 #include <openssl/err.h>
 #include <openssl/sha.h>
 #include <openssl/rsa.h>
+#include <openssl/rand.h>
+#include <openssl/kdf.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#endif
 
-const int numTrials = 5;
+#include "runcontrol.h"
+#include "verify.h"
+#include "parallel.h"
+#include "kdfsweep.h"
+#include "rngsweep.h"
+
+// Blocks processed per trial: 40960 blocks of 128 bytes simulate a 5MB file
+const int numBlocks = 40960;
 
 using namespace std;
 
@@ -27,6 +41,10 @@ void handleErrors(int status) {
 	} else if (status == 2) {
 		cout << "Something went wrong with hashing." << endl;
 		exit(EXIT_FAILURE);
+	} else if (status == 4) {
+		cout << "Something went wrong with key derivation." << endl;
+		ERR_print_errors_fp(stderr);
+		exit(EXIT_FAILURE);
 	} else {
 			ERR_print_errors_fp(stderr);
 		exit(EXIT_FAILURE);
@@ -42,9 +60,10 @@ void handleErrors(int status) {
  */
 int timeCipherOp(unsigned char *plaintext, unsigned int plaintext_len, const EVP_CIPHER* algo) {
 	clock_t start;
-	double e_duration=0, d_duration=0;
+	RunController run;
+	Sample e_time, d_time;
 
-	for(int i=0; i<numTrials; i++) {
+	while(run.next()) {
 
 		EVP_CIPHER_CTX *ctx;
 
@@ -53,12 +72,12 @@ int timeCipherOp(unsigned char *plaintext, unsigned int plaintext_len, const EVP
 
 		// Variables to store lengths
 		int lenE, lenD;
-		int ciphertext_len;
-		int decryptedtext_len;
+		int ciphertext_len = 0;
+		int decryptedtext_len = 0;
 
-		// Buffers from cipher and result
-		unsigned char ciphertext[512];
-		unsigned char decryptedtext[512];
+		// Buffers from cipher and result, large enough for every block plus padding
+		vector<unsigned char> ciphertext(numBlocks * plaintext_len + EVP_MAX_BLOCK_LENGTH);
+		vector<unsigned char> decryptedtext(ciphertext.size() + EVP_MAX_BLOCK_LENGTH);
 
 		/* Encrypt */
 
@@ -73,19 +92,20 @@ int timeCipherOp(unsigned char *plaintext, unsigned int plaintext_len, const EVP
 		// Time encryption
 		start = clock();
 
-		// Encrypt given message to provided output
-		for(int i=0; i<40960; i++) {
-			if(1 != EVP_EncryptUpdate(ctx, ciphertext, &lenE, plaintext, plaintext_len))
+		// Encrypt given message to provided output, each block after the last
+		for(int i=0; i<numBlocks; i++) {
+			if(1 != EVP_EncryptUpdate(ctx, &ciphertext[ciphertext_len], &lenE, plaintext, plaintext_len))
 					handleErrors(1);
-			ciphertext_len = lenE;
+			ciphertext_len += lenE;
 		}
 
 		// Finalize encryption
-		if(1 != EVP_EncryptFinal_ex(ctx, ciphertext + lenE, &lenE)) 
+		if(1 != EVP_EncryptFinal_ex(ctx, &ciphertext[ciphertext_len], &lenE)) 
 			handleErrors(1);
 		ciphertext_len += lenE;
+		doNotOptimize(ciphertext.data());
 
-		e_duration = e_duration + ( std::clock() - start ) / (double) CLOCKS_PER_SEC;
+		run.record(e_time, ( std::clock() - start ) / (double) CLOCKS_PER_SEC);
 
 		// Delete context object
 		EVP_CIPHER_CTX_free(ctx);
@@ -103,27 +123,36 @@ int timeCipherOp(unsigned char *plaintext, unsigned int plaintext_len, const EVP
 		// Time decryption
 		start = clock();
 
-		// Decrypt given message to provided output
-		for(int i=0; i<40960; i++) {
-			if(1 != EVP_DecryptUpdate(ctx, decryptedtext, &lenD, ciphertext, ciphertext_len))
+		// Decrypt the ciphertext in plaintext-sized chunks to provided output
+		for(int offset=0; offset<ciphertext_len; offset+=plaintext_len) {
+			int chunk_len = min((int) plaintext_len, ciphertext_len - offset);
+			if(1 != EVP_DecryptUpdate(ctx, &decryptedtext[decryptedtext_len], &lenD, &ciphertext[offset], chunk_len))
 					handleErrors(0);
-				decryptedtext_len = lenD;
+			decryptedtext_len += lenD;
 		}
 
 		// Finalize decryption
-		if(1 != EVP_DecryptFinal_ex(ctx, decryptedtext + lenD, &lenD)) 
+		if(1 != EVP_DecryptFinal_ex(ctx, &decryptedtext[decryptedtext_len], &lenD)) 
 			handleErrors(0);
-			decryptedtext_len += lenD;
+		decryptedtext_len += lenD;
+		doNotOptimize(decryptedtext.data());
 
-		d_duration = d_duration + ( std::clock() - start ) / (double) CLOCKS_PER_SEC;
+		run.record(d_time, ( std::clock() - start ) / (double) CLOCKS_PER_SEC);
 
 		// Delete context object
 		EVP_CIPHER_CTX_free(ctx);
 
+		// Every decrypted block must match the plaintext
+		verify(decryptedtext_len == numBlocks * (int) plaintext_len, "decrypted length");
+		for(int i=0; i<numBlocks; i++) {
+			verify(memcmp(&decryptedtext[i * plaintext_len], plaintext, plaintext_len) == 0, "cipher round trip");
+		}
+
 	}
 
-	cout << "Avg encryption time: " << e_duration/numTrials << endl;
-	cout << "Avg decryption time: " << d_duration/numTrials << endl;
+	run.report("Avg encryption time", e_time);
+	run.report("Avg decryption time", d_time);
+	run.finish();
 
 	return 0;
 }
@@ -136,9 +165,10 @@ int timeCipherOp(unsigned char *plaintext, unsigned int plaintext_len, const EVP
  */
 int timeRSAOp(unsigned char *plaintext, unsigned int plaintext_len) {
 	clock_t start;
-	double e_duration=0, d_duration=0;
+	RunController run;
+	Sample e_time, d_time;
 
-	for(int i=0; i<numTrials; i++) {
+	while(run.next()) {
 
 		// Generate RSA key
 		// Setup required data structures
@@ -157,7 +187,7 @@ int timeRSAOp(unsigned char *plaintext, unsigned int plaintext_len) {
 
 		unsigned char ciphertext[512];
 		unsigned char decryptedtext[512];
-		int encrypt_len, decrypt_len;
+		int encrypt_len, decrypt_len = 0;
 
 		// Time encryption
 		start = clock();
@@ -165,24 +195,29 @@ int timeRSAOp(unsigned char *plaintext, unsigned int plaintext_len) {
 			if((encrypt_len = RSA_public_encrypt(plaintext_len, plaintext, ciphertext, keypair, RSA_PKCS1_PADDING)) == -1) {
 				handleErrors(1);
 			}
+			doNotOptimize(ciphertext);
 		}
-		e_duration = e_duration + ( std::clock() - start ) / (double) CLOCKS_PER_SEC;
+		run.record(e_time, ( std::clock() - start ) / (double) CLOCKS_PER_SEC);
 
 		// Time decryption
 		start = clock();
 		for(int i=0; i<8192; i++) {
-			if(RSA_private_decrypt(encrypt_len, ciphertext, decryptedtext, keypair, RSA_PKCS1_PADDING) == -1) {
+			if((decrypt_len = RSA_private_decrypt(encrypt_len, ciphertext, decryptedtext, keypair, RSA_PKCS1_PADDING)) == -1) {
 				handleErrors(1);
 			}
+			doNotOptimize(decryptedtext);
 		}
-		d_duration = d_duration + ( std::clock() - start ) / (double) CLOCKS_PER_SEC;
+		run.record(d_time, ( std::clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		verify(sameBytes(decryptedtext, decrypt_len, plaintext, plaintext_len), "RSA round trip");
 
 		RSA_free(keypair);
 
 	}
 
-	cout << "Avg encryption time: " << e_duration/numTrials << endl;
-	cout << "Avg decryption time: " << d_duration/numTrials << endl;
+	run.report("Avg encryption time", e_time);
+	run.report("Avg decryption time", d_time);
+	run.finish();
 
 	return 0;
 }
@@ -195,9 +230,18 @@ int timeRSAOp(unsigned char *plaintext, unsigned int plaintext_len) {
  */
 void timeHashOp(unsigned char *message, unsigned int message_len) {
 	clock_t start;
-	double duration;
+	RunController run;
+	Sample h_time;
+
+	// Reference digest of the whole simulated file, hashed in one call
+	vector<unsigned char> file;
+	for(int i=0; i<numBlocks; i++) {
+		file.insert(file.end(), message, message + message_len);
+	}
+	unsigned char expected[SHA256_DIGEST_LENGTH];
+	SHA256(file.data(), file.size(), expected);
 
-	for(int i=0; i<numTrials; i++) {
+	while(run.next()) {
 		unsigned char digest[SHA256_DIGEST_LENGTH];
 
 		SHA256_CTX sha256;
@@ -207,24 +251,441 @@ void timeHashOp(unsigned char *message, unsigned int message_len) {
 		
 		// Hash operation
 		start = clock();
-		for(int i=0; i<40960; i++) {
+		for(int i=0; i<numBlocks; i++) {
 			if(1 != SHA256_Update(&sha256, message, message_len))
 				handleErrors(2);
 		}
 		if(1 != SHA256_Final(digest, &sha256))
 			handleErrors(2);
-		duration = duration + ( std::clock() - start ) / (double) CLOCKS_PER_SEC;
+		doNotOptimize(digest);
+		run.record(h_time, ( std::clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		verify(memcmp(digest, expected, sizeof(digest)) == 0, "incremental SHA256 digest");
 	}
 	
-	cout << "Avg hash time: " << duration/numTrials << endl;
+	run.report("Avg hash time", h_time);
+	run.finish();
 	return;
 }
 
 
+/*
+ * Private CTR-DRBG instance seeded from the operating system, as a service would keep per thread
+ * OpenSSL 3 exposes DRBGs through EVP_RAND, 1.1.1 through RAND_DRBG
+ */
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+typedef EVP_RAND_CTX DRBG;
+
+// Largest request a CTR-DRBG accepts in one generate call
+const size_t drbgMaxRequest = 1 << 16;
+
+DRBG* newDRBG() {
+	EVP_RAND *rand = EVP_RAND_fetch(NULL, "CTR-DRBG", NULL);
+	if(rand == NULL)
+		handleErrors(3);
+
+	DRBG *drbg = EVP_RAND_CTX_new(rand, NULL);
+	EVP_RAND_free(rand);
+	if(drbg == NULL)
+		handleErrors(3);
+
+	OSSL_PARAM params[2];
+	params[0] = OSSL_PARAM_construct_utf8_string(OSSL_DRBG_PARAM_CIPHER, (char *)"AES-256-CTR", 0);
+	params[1] = OSSL_PARAM_construct_end();
+	if(1 != EVP_RAND_instantiate(drbg, 256, 0, NULL, 0, params))
+		handleErrors(3);
+
+	return drbg;
+}
+
+void drbgBytes(DRBG *drbg, unsigned char *out, size_t len) {
+	for(size_t offset=0; offset<len; offset+=drbgMaxRequest) {
+		if(1 != EVP_RAND_generate(drbg, out + offset, min(drbgMaxRequest, len - offset), 256, 0, NULL, 0))
+			handleErrors(3);
+	}
+}
+
+void freeDRBG(DRBG *drbg) {
+	EVP_RAND_CTX_free(drbg);
+}
+
+// A DRBG that several threads call at once, serialised by its own lock
+DRBG* newSharedDRBG() {
+	DRBG *drbg = newDRBG();
+	if(1 != EVP_RAND_enable_locking(drbg))
+		handleErrors(3);
+	return drbg;
+}
+
+void sharedDRBGBytes(DRBG *drbg, unsigned char *out, size_t len) {
+	drbgBytes(drbg, out, len);
+}
+#else
+typedef RAND_DRBG DRBG;
+
+DRBG* newDRBG() {
+	DRBG *drbg = RAND_DRBG_new(0, 0, NULL);
+	if(drbg == NULL || 1 != RAND_DRBG_instantiate(drbg, NULL, 0))
+		handleErrors(3);
+	return drbg;
+}
+
+void drbgBytes(DRBG *drbg, unsigned char *out, size_t len) {
+	if(1 != RAND_DRBG_bytes(drbg, out, len))
+		handleErrors(3);
+}
+
+void freeDRBG(DRBG *drbg) {
+	RAND_DRBG_free(drbg);
+}
+
+// RAND_DRBG only locks OpenSSL's own instances, so a shared instance is serialised with a mutex
+mutex sharedDRBGLock;
+
+DRBG* newSharedDRBG() {
+	return newDRBG();
+}
+
+void sharedDRBGBytes(DRBG *drbg, unsigned char *out, size_t len) {
+	lock_guard<mutex> lock(sharedDRBGLock);
+	drbgBytes(drbg, out, len);
+}
+#endif
+
+/*
+ * Measures random number generation
+ * Prints the cost of a fresh DRBG, single-thread throughput per request size, and how nonce
+ * generation scales across threads with RAND_bytes, one locked DRBG shared by every thread, and
+ * per-thread instances
+ * Since 1.1.1 RAND_bytes draws from a thread-local public DRBG, so it does not contend on a lock;
+ * the shared DRBG shows what a single locked generator costs under contention
+ */
+void timeRandOp() {
+	clock_t start;
+
+	// Fresh instance: construction, seeding from the OS, and its first nonce
+	{
+		const int instances = 1000;
+		RunController run;
+		Sample c_time;
+		unsigned char nonce[nonceSize];
+
+		while(run.next()) {
+			start = clock();
+			for(int i=0; i<instances; i++) {
+				DRBG *drbg = newDRBG();
+				drbgBytes(drbg, nonce, sizeof(nonce));
+				doNotOptimize(nonce);
+				freeDRBG(drbg);
+			}
+			run.record(c_time, ( clock() - start ) / (double) CLOCKS_PER_SEC / instances);
+		}
+
+		run.report("Avg DRBG construction and seeding time", c_time);
+		run.finish();
+	}
+
+	// Single thread throughput
+	for(int size : randSizes) {
+		int calls = randCallsFor(size);
+		vector<unsigned char> buf(size);
+		DRBG *drbg = newDRBG();
+		RunController run;
+		Sample public_time, private_time;
+
+		while(run.next()) {
+			start = clock();
+			for(int i=0; i<calls; i++) {
+				if(1 != RAND_bytes(buf.data(), size))
+					handleErrors(3);
+				doNotOptimize(buf.data());
+			}
+			run.record(public_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+			start = clock();
+			for(int i=0; i<calls; i++) {
+				drbgBytes(drbg, buf.data(), size);
+				doNotOptimize(buf.data());
+			}
+			run.record(private_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+		}
+
+		double mb = (double) calls * size / 1e6;
+		run.reportRate("RAND_bytes (thread-local public DRBG) " + to_string(size) + " B", public_time, mb, "MB");
+		run.reportRate("Private DRBG " + to_string(size) + " B", private_time, mb, "MB");
+		run.finish();
+		freeDRBG(drbg);
+	}
+
+	// Nonce generation across threads; wall time, since the threads run concurrently
+	double public_base = 0, shared_base = 0, private_base = 0;
+
+	for(int threads : threadCounts()) {
+		DRBG *shared = newSharedDRBG();
+		vector<DRBG*> drbgs;
+		for(int t=0; t<threads; t++) {
+			drbgs.push_back(newDRBG());
+		}
+
+		RunController run;
+		Sample public_time, shared_time, private_time;
+
+		while(run.next()) {
+			run.record(public_time, timeParallel(threads, [&](int) {
+				unsigned char nonce[nonceSize];
+				for(int i=0; i<nonceCallsPerThread; i++) {
+					if(1 != RAND_bytes(nonce, sizeof(nonce)))
+						handleErrors(3);
+					doNotOptimize(nonce);
+				}
+			}));
+
+			run.record(shared_time, timeParallel(threads, [&](int) {
+				unsigned char nonce[nonceSize];
+				for(int i=0; i<nonceCallsPerThread; i++) {
+					sharedDRBGBytes(shared, nonce, sizeof(nonce));
+					doNotOptimize(nonce);
+				}
+			}));
+
+			run.record(private_time, timeParallel(threads, [&](int t) {
+				unsigned char nonce[nonceSize];
+				for(int i=0; i<nonceCallsPerThread; i++) {
+					drbgBytes(drbgs[t], nonce, sizeof(nonce));
+					doNotOptimize(nonce);
+				}
+			}));
+		}
+
+		double calls = (double) nonceCallsPerThread * threads;
+		double public_rate = calls / public_time.mean();
+		double shared_rate = calls / shared_time.mean();
+		double private_rate = calls / private_time.mean();
+		if(threads == 1) {
+			public_base = public_rate;
+			shared_base = shared_rate;
+			private_base = private_rate;
+		}
+
+		run.reportRate("RAND_bytes (thread-local public DRBG) nonces, " + to_string(threads) + " threads", public_time, calls, "calls");
+		cout << "  " << 100 * public_rate / (public_base * threads) << "% of linear scaling" << endl;
+		run.reportRate("Shared locked DRBG nonces, " + to_string(threads) + " threads", shared_time, calls, "calls");
+		cout << "  " << 100 * shared_rate / (shared_base * threads) << "% of linear scaling" << endl;
+		run.reportRate("Per-thread DRBG nonces, " + to_string(threads) + " threads", private_time, calls, "calls");
+		cout << "  " << 100 * private_rate / (private_base * threads) << "% of linear scaling" << endl;
+		run.finish();
+
+		freeDRBG(shared);
+		for(DRBG *drbg : drbgs) {
+			freeDRBG(drbg);
+		}
+	}
+}
+
+/*
+ * Key derivation functions
+ * Each derives out_len bytes into out and exits on failure
+ */
+void pbkdf2(const char *pass, size_t pass_len, const unsigned char *salt, size_t salt_len,
+		unsigned long iterations, unsigned char *out, size_t out_len) {
+	if(1 != PKCS5_PBKDF2_HMAC(pass, pass_len, salt, salt_len, iterations, EVP_sha256(), out_len, out))
+		handleErrors(4);
+}
+
+void scrypt(const char *pass, size_t pass_len, const unsigned char *salt, size_t salt_len,
+		const ScryptSetting& setting, unsigned char *out, size_t out_len) {
+	// Allow exactly the memory the setting needs; the default limit is 32MB
+	uint64_t max_mem = 128 * setting.r * (setting.N + 2) + 128 * setting.r * setting.p;
+	if(1 != EVP_PBE_scrypt(pass, pass_len, salt, salt_len, setting.N, setting.r, setting.p, max_mem, out, out_len))
+		handleErrors(4);
+}
+
+void hkdf(const unsigned char *key, size_t key_len, const unsigned char *salt, size_t salt_len,
+		const unsigned char *info, size_t info_len, unsigned char *out, size_t out_len) {
+	EVP_PKEY_CTX *pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, NULL);
+	if(pctx == NULL
+		|| 1 != EVP_PKEY_derive_init(pctx)
+		|| 1 != EVP_PKEY_CTX_set_hkdf_md(pctx, EVP_sha256())
+		|| 1 != EVP_PKEY_CTX_set1_hkdf_salt(pctx, salt, salt_len)
+		|| 1 != EVP_PKEY_CTX_set1_hkdf_key(pctx, key, key_len)
+		|| 1 != EVP_PKEY_CTX_add1_hkdf_info(pctx, info, info_len)
+		|| 1 != EVP_PKEY_derive(pctx, out, &out_len))
+		handleErrors(4);
+	EVP_PKEY_CTX_free(pctx);
+}
+
+// Argon2 is only available from OpenSSL 3.2
+#if OPENSSL_VERSION_NUMBER >= 0x30200000L
+void argon2id(const char *pass, size_t pass_len, const unsigned char *salt, size_t salt_len,
+		const Argon2Setting& setting, unsigned char *out, size_t out_len) {
+	EVP_KDF *kdf = EVP_KDF_fetch(NULL, "ARGON2ID", NULL);
+	EVP_KDF_CTX *kctx = kdf == NULL ? NULL : EVP_KDF_CTX_new(kdf);
+	EVP_KDF_free(kdf);
+	if(kctx == NULL)
+		handleErrors(4);
+
+	uint32_t iterations = setting.iterations, memory = setting.memory_kib, lanes = setting.lanes;
+	OSSL_PARAM params[6];
+	params[0] = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_PASSWORD, (void *) pass, pass_len);
+	params[1] = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_SALT, (void *) salt, salt_len);
+	params[2] = OSSL_PARAM_construct_uint32(OSSL_KDF_PARAM_ITER, &iterations);
+	params[3] = OSSL_PARAM_construct_uint32(OSSL_KDF_PARAM_ARGON2_MEMCOST, &memory);
+	params[4] = OSSL_PARAM_construct_uint32(OSSL_KDF_PARAM_ARGON2_LANES, &lanes);
+	params[5] = OSSL_PARAM_construct_end();
+
+	if(1 != EVP_KDF_derive(kctx, out, out_len, params))
+		handleErrors(4);
+	EVP_KDF_CTX_free(kctx);
+}
+#endif
+
+/*
+ * Performs key derivation across the settings in kdfsweep.h
+ * Prints latency, logins per second per core and memory for each setting
+ */
+void timeKDFOp() {
+	const unsigned char *salt = (const unsigned char *) kdfSalt;
+	size_t salt_len = strlen(kdfSalt);
+	size_t pass_len = strlen(kdfPassword);
+	vector<vector<unsigned char>> keys(kdfMaxThreads(), vector<unsigned char>(kdfKeyLength));
+
+	for(unsigned long iterations : pbkdf2Iterations) {
+		timeKDFSetting("PBKDF2-HMAC-SHA256 iterations=" + to_string(iterations), 0, 1, "logins", [&](int t) {
+			pbkdf2(kdfPassword, pass_len, salt, salt_len, iterations, keys[t].data(), keys[t].size());
+			doNotOptimize(keys[t].data());
+		});
+	}
+
+	for(const ScryptSetting& setting : scryptSettings) {
+		string label = "scrypt N=" + to_string(setting.N) + " r=" + to_string(setting.r) + " p=" + to_string(setting.p);
+		timeKDFSetting(label, scryptMemoryKiB(setting), 1, "logins", [&](int t) {
+			scrypt(kdfPassword, pass_len, salt, salt_len, setting, keys[t].data(), keys[t].size());
+			doNotOptimize(keys[t].data());
+		});
+	}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30200000L
+	for(const Argon2Setting& setting : argon2Settings) {
+		string label = "Argon2id m=" + to_string(setting.memory_kib) + " KiB t=" + to_string(setting.iterations)
+			+ " p=" + to_string(setting.lanes);
+		timeKDFSetting(label, setting.memory_kib, 1, "logins", [&](int t) {
+			argon2id(kdfPassword, pass_len, salt, salt_len, setting, keys[t].data(), keys[t].size());
+			doNotOptimize(keys[t].data());
+		});
+	}
+#else
+	cout << "Argon2id requires OpenSSL 3.2 or later, skipped" << endl;
+#endif
+
+	// HKDF is cheap, so each call performs a batch of derivations from the key derived above
+	const int batch = 1000;
+	const unsigned char *info = (const unsigned char *) "login session";
+	const vector<unsigned char>& key = keys[0];
+	for(size_t length : hkdfLengths) {
+		vector<vector<unsigned char>> outs(kdfMaxThreads(), vector<unsigned char>(length));
+		timeKDFSetting("HKDF-SHA256 L=" + to_string(length), 0, batch, "derivations", [&](int t) {
+			for(int i=0; i<batch; i++) {
+				hkdf(key.data(), key.size(), salt, salt_len, info, strlen((const char *) info), outs[t].data(), outs[t].size());
+				doNotOptimize(outs[t].data());
+			}
+		});
+	}
+}
+
+/*
+ * Checks each primitive against published test vectors
+ * Exits if any result differs
+ */
+void runKnownAnswerTests() {
+	EVP_CIPHER_CTX *ctx;
+	int len, out_len;
+
+	// AES-256 single block, no padding
+	vector<unsigned char> key = fromHex(aes256KatKey);
+	vector<unsigned char> pt = fromHex(aes256KatPlaintext);
+	vector<unsigned char> ct = fromHex(aes256KatCiphertext);
+	vector<unsigned char> out(pt.size() + EVP_MAX_BLOCK_LENGTH);
+
+	if(!(ctx = EVP_CIPHER_CTX_new()))
+		handleErrors(1);
+	if(1 != EVP_EncryptInit_ex(ctx, EVP_aes_256_ecb(), NULL, key.data(), NULL))
+		handleErrors(1);
+	EVP_CIPHER_CTX_set_padding(ctx, 0);
+	if(1 != EVP_EncryptUpdate(ctx, out.data(), &len, pt.data(), pt.size()))
+		handleErrors(1);
+	out_len = len;
+	if(1 != EVP_EncryptFinal_ex(ctx, out.data() + out_len, &len))
+		handleErrors(1);
+	out_len += len;
+	EVP_CIPHER_CTX_free(ctx);
+	verify(sameBytes(out.data(), out_len, ct.data(), ct.size()), "AES-256 known answer");
+
+	// ChaCha20; the OpenSSL IV is the 32-bit little-endian block counter followed by the nonce
+	key = fromHex(chachaKatKey);
+	vector<unsigned char> iv = fromHex("01000000");
+	vector<unsigned char> nonce = fromHex(chachaKatNonce);
+	iv.insert(iv.end(), nonce.begin(), nonce.end());
+	pt.assign(chachaKatPlaintext, chachaKatPlaintext + strlen(chachaKatPlaintext));
+	ct = fromHex(chachaKatCiphertext);
+	out.assign(pt.size(), 0);
+
+	if(!(ctx = EVP_CIPHER_CTX_new()))
+		handleErrors(1);
+	if(1 != EVP_EncryptInit_ex(ctx, EVP_chacha20(), NULL, key.data(), iv.data()))
+		handleErrors(1);
+	if(1 != EVP_EncryptUpdate(ctx, out.data(), &len, pt.data(), pt.size()))
+		handleErrors(1);
+	EVP_CIPHER_CTX_free(ctx);
+	verify(sameBytes(out.data(), len, ct.data(), ct.size()), "ChaCha20 known answer");
+
+	// SHA256
+	unsigned char digest[SHA256_DIGEST_LENGTH];
+	vector<unsigned char> expected = fromHex(sha256KatDigest);
+	SHA256((const unsigned char *) sha256KatMessage, strlen(sha256KatMessage), digest);
+	verify(sameBytes(digest, sizeof(digest), expected.data(), expected.size()), "SHA256 known answer");
+
+	// PBKDF2-HMAC-SHA256
+	expected = fromHex(pbkdf2KatKey);
+	out.assign(expected.size(), 0);
+	pbkdf2(pbkdf2KatPassword, strlen(pbkdf2KatPassword), (const unsigned char *) pbkdf2KatSalt, strlen(pbkdf2KatSalt),
+		pbkdf2KatIterations, out.data(), out.size());
+	verify(out == expected, "PBKDF2 known answer");
+
+	// scrypt
+	ScryptSetting scrypt_kat = { scryptKatN, scryptKatR, scryptKatP };
+	expected = fromHex(scryptKatKey);
+	out.assign(expected.size(), 0);
+	scrypt(scryptKatPassword, strlen(scryptKatPassword), (const unsigned char *) scryptKatSalt, strlen(scryptKatSalt),
+		scrypt_kat, out.data(), out.size());
+	verify(out == expected, "scrypt known answer");
+
+#if OPENSSL_VERSION_NUMBER >= 0x30200000L
+	// Argon2id
+	Argon2Setting argon2_kat = { argon2idKatMemory, argon2idKatIterations, argon2idKatLanes };
+	expected = fromHex(argon2idKatKey);
+	out.assign(expected.size(), 0);
+	argon2id(argon2idKatPassword, strlen(argon2idKatPassword), (const unsigned char *) argon2idKatSalt,
+		strlen(argon2idKatSalt), argon2_kat, out.data(), out.size());
+	verify(out == expected, "Argon2id known answer");
+#endif
+
+	// HKDF-SHA256
+	key = fromHex(hkdfKatKey);
+	vector<unsigned char> salt = fromHex(hkdfKatSalt), info = fromHex(hkdfKatInfo);
+	expected = fromHex(hkdfKatOutput);
+	out.assign(expected.size(), 0);
+	hkdf(key.data(), key.size(), salt.data(), salt.size(), info.data(), info.size(), out.data(), out.size());
+	verify(out == expected, "HKDF known answer");
+
+	cout << "Known-answer tests passed" << endl << endl;
+}
+
 int main() {
-	const EVP_CIPHER* aes256 = EVP_aes_128_ecb();
+	const EVP_CIPHER* aes256 = EVP_aes_256_ecb();
 	const EVP_CIPHER* chacha = EVP_chacha20();
 
+	runKnownAnswerTests();
+
 	// Instead of using 5MB string, use 128 bytes instead
 	// In each crypto primitive, do 40960 operations of 128 bytes 
 	// to simulate performing operations on 5MB file
@@ -235,25 +696,37 @@ int main() {
 	/* AES */
 	cout << "=========================================================================" << endl;
 	cout << "AES256 Operations" << endl;
-	timeCipherOp(plaintext, strlen ((char *)plaintext), aes256);
+	timeCipherOp(plaintext, sizeof(plaintext), aes256);
 	cout << "=========================================================================" << endl << endl;
 
 	/* ChaCha */
 	cout << "=========================================================================" << endl;
 	cout << "ChaCha Operations" << endl;
-	timeCipherOp(plaintext, strlen ((char *)plaintext), chacha);
+	timeCipherOp(plaintext, sizeof(plaintext), chacha);
 	cout << "=========================================================================" << endl << endl;
 
 	/* SHA256 Hash */
 	cout << "=========================================================================" << endl;
 	cout << "SHA256 Hash" << endl;
-	timeHashOp(plaintext, strlen ((char *)plaintext));
+	timeHashOp(plaintext, sizeof(plaintext));
 	cout << "=========================================================================" << endl << endl;
 
 	/* RSA Encryption */
 	cout << "=========================================================================" << endl;
 	cout << "RSA Operations" << endl;
-	timeRSAOp(plaintext, strlen ((char *)plaintext));
+	timeRSAOp(plaintext, sizeof(plaintext));
+	cout << "=========================================================================" << endl << endl;
+
+	/* Key derivation */
+	cout << "=========================================================================" << endl;
+	cout << "KDF Operations" << endl;
+	timeKDFOp();
+	cout << "=========================================================================" << endl << endl;
+
+	/* Random number generation */
+	cout << "=========================================================================" << endl;
+	cout << "RNG Operations" << endl;
+	timeRandOp();
 	cout << "=========================================================================" << endl << endl;
 	
 	return 0;
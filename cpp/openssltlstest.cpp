@@ -0,0 +1,396 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <csignal>
+
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include "runcontrol.h"
+#include "verify.h"
+#include "parallel.h"
+#include "tlsbench.h"
+
+using namespace std;
+
+// Error handler; prints an error and exits program
+void handleErrors(const string& what) {
+	cout << "Something went wrong with " << what << "." << endl;
+	ERR_print_errors_fp(stderr);
+	exit(EXIT_FAILURE);
+}
+
+/*
+ * Generates a server key
+ * @type: EVP_PKEY_RSA for RSA-2048, or EVP_PKEY_EC for ECDSA P-256
+ */
+EVP_PKEY* generateKey(int type) {
+	EVP_PKEY *key = NULL;
+	EVP_PKEY_CTX *pctx = EVP_PKEY_CTX_new_id(type, NULL);
+
+	if(pctx == NULL || EVP_PKEY_keygen_init(pctx) <= 0)
+		handleErrors("key generation");
+	if(type == EVP_PKEY_RSA && EVP_PKEY_CTX_set_rsa_keygen_bits(pctx, 2048) <= 0)
+		handleErrors("key generation");
+	if(type == EVP_PKEY_EC && EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pctx, NID_X9_62_prime256v1) <= 0)
+		handleErrors("key generation");
+	if(EVP_PKEY_keygen(pctx, &key) <= 0)
+		handleErrors("key generation");
+
+	EVP_PKEY_CTX_free(pctx);
+	return key;
+}
+
+/*
+ * Issues a self-signed certificate for localhost
+ * @key: key to certify and sign with
+ */
+X509* selfSign(EVP_PKEY *key) {
+	X509 *cert = X509_new();
+	if(cert == NULL)
+		handleErrors("certificate creation");
+
+	X509_set_version(cert, 2);
+	ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+	X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+	X509_gmtime_adj(X509_getm_notAfter(cert), 86400);
+	X509_set_pubkey(cert, key);
+
+	X509_NAME *name = X509_get_subject_name(cert);
+	X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char *) "localhost", -1, -1, 0);
+	X509_set_issuer_name(cert, name);
+
+	// Clients check the host name against the subjectAltName
+	X509V3_CTX v3;
+	X509V3_set_ctx_nodb(&v3);
+	X509V3_set_ctx(&v3, cert, cert, NULL, NULL, 0);
+	X509_EXTENSION *ext = X509V3_EXT_conf_nid(NULL, &v3, NID_subject_alt_name, (char *) "DNS:localhost");
+	if(ext == NULL || 1 != X509_add_ext(cert, ext, -1))
+		handleErrors("certificate creation");
+	X509_EXTENSION_free(ext);
+
+	if(X509_sign(cert, key, EVP_sha256()) <= 0)
+		handleErrors("certificate creation");
+
+	return cert;
+}
+
+/*
+ * Settings of one benchmark run
+ */
+struct TLSConfig {
+	// Description for output
+	string name;
+	// TLS1_2_VERSION or TLS1_3_VERSION
+	int version;
+	EVP_PKEY *key;
+	X509 *cert;
+	// Cipher suite to negotiate; empty for the library default
+	string cipher;
+};
+
+// Restricts a context to the configured protocol version and cipher suite
+void configureContext(SSL_CTX *ctx, const TLSConfig& config) {
+	if(1 != SSL_CTX_set_min_proto_version(ctx, config.version) || 1 != SSL_CTX_set_max_proto_version(ctx, config.version))
+		handleErrors("protocol configuration");
+
+	if(!config.cipher.empty()) {
+		int ok = config.version == TLS1_3_VERSION
+			? SSL_CTX_set_ciphersuites(ctx, config.cipher.c_str())
+			: SSL_CTX_set_cipher_list(ctx, config.cipher.c_str());
+		if(1 != ok)
+			handleErrors("cipher suite configuration");
+	}
+}
+
+SSL_CTX* serverContext(const TLSConfig& config) {
+	SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+	if(ctx == NULL)
+		handleErrors("server context creation");
+
+	configureContext(ctx, config);
+	if(1 != SSL_CTX_use_certificate(ctx, config.cert) || 1 != SSL_CTX_use_PrivateKey(ctx, config.key))
+		handleErrors("server certificate configuration");
+
+	const unsigned char session_context[] = "cryptocomparison";
+	SSL_CTX_set_session_id_context(ctx, session_context, sizeof(session_context) - 1);
+	return ctx;
+}
+
+SSL_CTX* clientContext(const TLSConfig& config) {
+	SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+	if(ctx == NULL)
+		handleErrors("client context creation");
+
+	configureContext(ctx, config);
+
+	// Trust the server's self-signed certificate and verify it on every full handshake
+	if(1 != X509_STORE_add_cert(SSL_CTX_get_cert_store(ctx), config.cert))
+		handleErrors("client trust store configuration");
+	SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, NULL);
+	return ctx;
+}
+
+/*
+ * Serves one connection
+ * Completes the handshake, sends a byte so the client knows, then reads until the client closes,
+ * acknowledging each complete bulk transfer with another byte
+ * @ctx: server context
+ * @fd: accepted socket
+ */
+void serveConnection(SSL_CTX *ctx, int fd) {
+	SSL *ssl = SSL_new(ctx);
+	if(ssl == NULL || 1 != SSL_set_fd(ssl, fd))
+		handleErrors("server connection setup");
+
+	if(SSL_accept(ssl) == 1 && SSL_write(ssl, "k", 1) == 1) {
+		vector<unsigned char> record(recordSize);
+		size_t received = 0;
+		int len;
+
+		while((len = SSL_read(ssl, record.data(), record.size())) > 0) {
+			received += len;
+			if(received == bulkBytesPerConnection) {
+				received = 0;
+				if(SSL_write(ssl, "k", 1) != 1)
+					break;
+			}
+		}
+
+		// Close cleanly so the session stays resumable
+		SSL_shutdown(ssl);
+	}
+
+	SSL_free(ssl);
+	close(fd);
+}
+
+/*
+ * Connects to the server and completes a handshake, up to the server's first byte
+ * Returns the established connection
+ * @ctx: client context
+ * @config: settings, to check the negotiated cipher suite
+ * @port: server port
+ * @session: session to resume, or NULL for a full handshake
+ */
+SSL* clientConnect(SSL_CTX *ctx, const TLSConfig& config, int port, SSL_SESSION *session) {
+	int fd = connectLoopback(port);
+	SSL *ssl = SSL_new(ctx);
+	if(ssl == NULL || 1 != SSL_set_fd(ssl, fd) || 1 != SSL_set1_host(ssl, "localhost"))
+		handleErrors("client connection setup");
+	if(session != NULL && 1 != SSL_set_session(ssl, session))
+		handleErrors("client connection setup");
+
+	char ack;
+	if(SSL_connect(ssl) != 1)
+		handleErrors("the TLS handshake");
+	if(SSL_read(ssl, &ack, 1) != 1 || ack != 'k')
+		handleErrors("reading the handshake acknowledgement");
+
+	verify(SSL_session_reused(ssl) == (session != NULL), session != NULL ? "session resumption" : "full handshake");
+	verify(config.cipher.empty() || config.cipher == SSL_CIPHER_get_name(SSL_get_current_cipher(ssl)), "negotiated cipher suite");
+	return ssl;
+}
+
+// Closes a client connection cleanly
+void clientClose(SSL *ssl) {
+	int fd = SSL_get_fd(ssl);
+	SSL_shutdown(ssl);
+	SSL_free(ssl);
+	close(fd);
+}
+
+/*
+ * Runs one loopback load trial
+ * Starts a server thread per connection, runs setup on every client, then times work on every client
+ * Returns the wall time of the work
+ * @ctx: server context
+ * @connections: number of concurrent connections
+ * @setup: untimed client preparation, taking the client index and server port
+ * @work: timed client work, taking the client index and server port
+ */
+template <typename Setup, typename Work>
+double runLoad(SSL_CTX *ctx, int connections, Setup setup, Work work) {
+	int port;
+	int listen_fd = listenLoopback(&port);
+
+	vector<thread> servers;
+	for(int t=0; t<connections; t++) {
+		servers.push_back(thread([&]() {
+			int fd;
+			while((fd = acceptLoopback(listen_fd)) >= 0) {
+				serveConnection(ctx, fd);
+			}
+		}));
+	}
+
+	timeParallel(connections, [&](int t) { setup(t, port); });
+	double seconds = timeParallel(connections, [&](int t) { work(t, port); });
+
+	closeListener(listen_fd);
+	for(thread& server : servers) {
+		server.join();
+	}
+	return seconds;
+}
+
+/*
+ * Performs repeated handshakes on concurrent connections
+ * Prints handshakes per second and the client-side latency histogram for each connection count
+ * Latency runs from TCP connect until the server's first application byte arrives
+ * @config: settings of the run
+ * @resume: resume a session from the previous handshake instead of doing full handshakes
+ */
+void timeHandshakeOp(const TLSConfig& config, bool resume) {
+	SSL_CTX *server_ctx = serverContext(config);
+	SSL_CTX *client_ctx = clientContext(config);
+	string mode = resume ? " resumed" : " full";
+
+	for(int connections : connectionCounts) {
+		RunController run;
+		Sample h_time;
+		LatencyHistogram latency;
+		vector<SSL_SESSION*> sessions(connections, (SSL_SESSION *) NULL);
+
+		while(run.next()) {
+			vector<LatencyHistogram> per_client(connections);
+
+			double seconds = runLoad(server_ctx, connections, [&](int t, int port) {
+				// Resumed runs start from a session of an untimed full handshake
+				if(resume && sessions[t] == NULL) {
+					SSL *ssl = clientConnect(client_ctx, config, port, NULL);
+					sessions[t] = SSL_get1_session(ssl);
+					clientClose(ssl);
+				}
+			}, [&](int t, int port) {
+				for(int i=0; i<handshakesPerConnection; i++) {
+					double start = wallTime();
+					SSL *ssl = clientConnect(client_ctx, config, port, resume ? sessions[t] : NULL);
+					per_client[t].add(wallTime() - start);
+
+					// Continue from the newest session; TLS 1.3 issues a new ticket on every handshake
+					if(resume) {
+						SSL_SESSION_free(sessions[t]);
+						sessions[t] = SSL_get1_session(ssl);
+					}
+					clientClose(ssl);
+				}
+			});
+
+			run.record(h_time, seconds);
+			if(run.trials() > 0) {
+				for(const LatencyHistogram& client : per_client) {
+					latency.merge(client);
+				}
+			}
+		}
+
+		string label = config.name + mode + " handshakes, " + to_string(connections) + " connections";
+		run.reportRate(label, h_time, (double) connections * handshakesPerConnection, "handshakes");
+		latency.print(label);
+		run.finish();
+
+		for(SSL_SESSION *session : sessions) {
+			SSL_SESSION_free(session);
+		}
+	}
+
+	SSL_CTX_free(client_ctx);
+	SSL_CTX_free(server_ctx);
+}
+
+/*
+ * Sends bulk application data on concurrent established connections
+ * Prints aggregate throughput for each connection count; handshakes are not timed
+ * @config: settings of the run, naming the cipher suite
+ */
+void timeBulkOp(const TLSConfig& config) {
+	SSL_CTX *server_ctx = serverContext(config);
+	SSL_CTX *client_ctx = clientContext(config);
+	vector<unsigned char> record(recordSize, 'a');
+
+	for(int connections : connectionCounts) {
+		RunController run;
+		Sample b_time;
+
+		while(run.next()) {
+			vector<SSL*> ssls(connections, (SSL *) NULL);
+
+			double seconds = runLoad(server_ctx, connections, [&](int t, int port) {
+				ssls[t] = clientConnect(client_ctx, config, port, NULL);
+			}, [&](int t, int) {
+				for(size_t sent=0; sent<bulkBytesPerConnection; sent+=recordSize) {
+					if(SSL_write(ssls[t], record.data(), record.size()) != (int) record.size())
+						handleErrors("sending application data");
+				}
+
+				// Server acknowledges once it has read every byte
+				char ack;
+				if(SSL_read(ssls[t], &ack, 1) != 1 || ack != 'k')
+					handleErrors("reading the transfer acknowledgement");
+				clientClose(ssls[t]);
+			});
+
+			run.record(b_time, seconds);
+		}
+
+		run.reportRate(config.name + " bulk, " + to_string(connections) + " connections", b_time,
+			(double) connections * bulkBytesPerConnection / 1e6, "MB");
+		run.finish();
+	}
+
+	SSL_CTX_free(client_ctx);
+	SSL_CTX_free(server_ctx);
+}
+
+int main() {
+	// A peer closing mid-write must surface as an error, not kill the process
+	signal(SIGPIPE, SIG_IGN);
+
+	EVP_PKEY *rsa_key = generateKey(EVP_PKEY_RSA);
+	EVP_PKEY *ec_key = generateKey(EVP_PKEY_EC);
+	X509 *rsa_cert = selfSign(rsa_key);
+	X509 *ec_cert = selfSign(ec_key);
+
+	const TLSConfig handshakeConfigs[] = {
+		{ "TLS1.2 RSA-2048", TLS1_2_VERSION, rsa_key, rsa_cert, "" },
+		{ "TLS1.2 ECDSA-P256", TLS1_2_VERSION, ec_key, ec_cert, "" },
+		{ "TLS1.3 RSA-2048", TLS1_3_VERSION, rsa_key, rsa_cert, "" },
+		{ "TLS1.3 ECDSA-P256", TLS1_3_VERSION, ec_key, ec_cert, "" },
+	};
+
+	const TLSConfig bulkConfigs[] = {
+		{ "TLS1.2 ECDHE-RSA-AES128-GCM-SHA256", TLS1_2_VERSION, rsa_key, rsa_cert, "ECDHE-RSA-AES128-GCM-SHA256" },
+		{ "TLS1.2 ECDHE-RSA-AES256-GCM-SHA384", TLS1_2_VERSION, rsa_key, rsa_cert, "ECDHE-RSA-AES256-GCM-SHA384" },
+		{ "TLS1.2 ECDHE-RSA-CHACHA20-POLY1305", TLS1_2_VERSION, rsa_key, rsa_cert, "ECDHE-RSA-CHACHA20-POLY1305" },
+		{ "TLS1.3 TLS_AES_128_GCM_SHA256", TLS1_3_VERSION, rsa_key, rsa_cert, "TLS_AES_128_GCM_SHA256" },
+		{ "TLS1.3 TLS_AES_256_GCM_SHA384", TLS1_3_VERSION, rsa_key, rsa_cert, "TLS_AES_256_GCM_SHA384" },
+		{ "TLS1.3 TLS_CHACHA20_POLY1305_SHA256", TLS1_3_VERSION, rsa_key, rsa_cert, "TLS_CHACHA20_POLY1305_SHA256" },
+	};
+
+	cout << "=========================================================================" << endl;
+	cout << "TLS Handshakes" << endl;
+	for(const TLSConfig& config : handshakeConfigs) {
+		timeHandshakeOp(config, false);
+		timeHandshakeOp(config, true);
+	}
+	cout << "=========================================================================" << endl << endl;
+
+	cout << "=========================================================================" << endl;
+	cout << "TLS Bulk Transfer" << endl;
+	for(const TLSConfig& config : bulkConfigs) {
+		timeBulkOp(config);
+	}
+	cout << "=========================================================================" << endl << endl;
+
+	X509_free(ec_cert);
+	X509_free(rsa_cert);
+	EVP_PKEY_free(ec_key);
+	EVP_PKEY_free(rsa_key);
+
+	return 0;
+}
@@ -0,0 +1,63 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "runcontrol.h"
+
+/*
+ * Thread scaling helpers shared by the C++ benchmarks (C++11)
+ */
+
+// Thread counts to sweep: powers of two up to the number of hardware threads, and at least 2
+inline std::vector<int> threadCounts() {
+	int max_threads = std::thread::hardware_concurrency();
+	if(max_threads < 2) {
+		max_threads = 2;
+	}
+
+	std::vector<int> counts;
+	for(int t=1; t<max_threads; t*=2) {
+		counts.push_back(t);
+	}
+	counts.push_back(max_threads);
+	return counts;
+}
+
+/*
+ * Runs work on several threads that are released at the same moment
+ * Returns wall time from release until the last thread finishes; thread start-up is not included
+ * @threads: number of threads
+ * @work: callable taking the thread index
+ */
+template <typename Work>
+double timeParallel(int threads, Work work) {
+	std::atomic<int> ready(0);
+	std::atomic<bool> go(false);
+	std::vector<std::thread> pool;
+
+	for(int t=0; t<threads; t++) {
+		pool.push_back(std::thread([&, t]() {
+			ready++;
+			while(!go) {
+				std::this_thread::yield();
+			}
+			work(t);
+		}));
+	}
+
+	while(ready < threads) {
+		std::this_thread::yield();
+	}
+
+	double start = wallTime();
+	go = true;
+	for(std::thread& thread : pool) {
+		thread.join();
+	}
+	return wallTime() - start;
+}
+
+#endif
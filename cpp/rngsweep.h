@@ -0,0 +1,23 @@
+#ifndef RNGSWEEP_H
+#define RNGSWEEP_H
+
+/*
+ * RNG request sizes and counts shared by openssltest and botantest, so both libraries are measured
+ * on the same requests
+ */
+
+// RNG request sizes: an AEAD nonce, a 256-bit key, and a bulk fill
+const int randSizes[] = { 12, 32, 1048576 };
+
+// Size of the nonce requests used for the thread scaling runs
+const int nonceSize = 12;
+
+// Nonces each thread requests per trial in the thread scaling runs
+const int nonceCallsPerThread = 20000;
+
+// Requests per trial: enough small requests to dwarf timer resolution, fewer bulk ones
+inline int randCallsFor(int size) {
+	return size >= 4096 ? 16 : 100000;
+}
+
+#endif
@@ -0,0 +1,370 @@
+#ifndef RUNCONTROL_H
+#define RUNCONTROL_H
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <unistd.h>
+
+/*
+ * Run control shared by the C++ benchmarks
+ * Each timed loop runs warm-up trials that are thrown away, then keeps running trials until the
+ * 95% confidence interval of every recorded timing is within the target width of its mean.
+ * The host is checked once for frequency scaling, turbo, SMT and other runnable tasks before anything
+ * is measured; on a noisy host every reported result is marked NOISY-HOST.
+ *
+ * Settings are read from the environment:
+ * BENCH_WARMUP: warm-up trials per loop (default 1)
+ * BENCH_MIN_TRIALS: measured trials before convergence is checked (default 5)
+ * BENCH_MAX_TRIALS: measured trials after which an unconverged loop gives up (default 30)
+ * BENCH_CI_TARGET: confidence interval half-width relative to the mean (default 0.02)
+ * BENCH_STRICT: if 1, refuse to run on a noisy host and fail when a loop does not converge
+ */
+
+// Reads a numeric setting from the environment, falling back to a default
+inline double runSetting(const char* name, double fallback) {
+	const char* value = getenv(name);
+	if(value == NULL || *value == '\0') {
+		return fallback;
+	}
+	return atof(value);
+}
+
+// Monotonic wall-clock time in seconds, for timings that span several threads or wait on I/O
+inline double wallTime() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Reads the first line of a sysfs/procfs file, empty if it does not exist
+inline std::string readFirstLine(const std::string& path) {
+	std::ifstream in(path.c_str());
+	std::string line;
+	std::getline(in, line);
+	return line;
+}
+
+/*
+ * Collects the timings of one operation across trials
+ */
+class Sample {
+public:
+	void add(double t) {
+		values.push_back(t);
+	}
+
+	size_t count() const {
+		return values.size();
+	}
+
+	double mean() const {
+		if(values.empty()) {
+			return 0;
+		}
+		double sum = 0;
+		for(size_t i=0; i<values.size(); i++) {
+			sum += values[i];
+		}
+		return sum / values.size();
+	}
+
+	double stddev() const {
+		if(values.size() < 2) {
+			return 0;
+		}
+		double m = mean(), sq = 0;
+		for(size_t i=0; i<values.size(); i++) {
+			sq += (values[i] - m) * (values[i] - m);
+		}
+		return sqrt(sq / (values.size() - 1));
+	}
+
+	// Half-width of the 95% confidence interval of the mean, relative to the mean
+	double relativeCI() const {
+		// Two-sided 95% Student t critical values for 1..30 degrees of freedom
+		static const double t95[] = {
+			12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+			2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+			2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+		};
+
+		size_t n = values.size();
+		double m = mean();
+		if(n < 2) {
+			return HUGE_VAL;
+		}
+		if(m <= 0) {
+			return 0;
+		}
+		double t = n - 1 <= 30 ? t95[n - 2] : 1.96;
+		return t * stddev() / sqrt((double) n) / m;
+	}
+
+private:
+	std::vector<double> values;
+};
+
+/*
+ * Counts runnable tasks other than this process, from the 4th field of /proc/loadavg
+ * The load average is not used: it ignores the CPU count and still carries the load of a benchmark
+ * that has just finished. The count is a snapshot, so it is sampled a few times and the minimum
+ * is taken, which ignores tasks that only wake briefly
+ */
+inline int otherRunnableTasks() {
+	int fewest = -1;
+	for(int i=0; i<5; i++) {
+		std::istringstream loadavg(readFirstLine("/proc/loadavg"));
+		std::string skip, tasks;
+		loadavg >> skip >> skip >> skip >> tasks;
+		if(tasks.empty()) {
+			return 0;
+		}
+
+		// Runnable count includes the process reading it
+		int others = atoi(tasks.c_str()) - 1;
+		if(fewest < 0 || others < fewest) {
+			fewest = others;
+		}
+		usleep(10000);
+	}
+	return fewest > 0 ? fewest : 0;
+}
+
+/*
+ * Checks the host for sources of timing noise
+ * Returns a description of each problem found; missing sysfs entries are not reported
+ */
+inline std::vector<std::string> checkHost() {
+	std::vector<std::string> problems;
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	// Frequency scaling: anything but the performance governor changes clock speed under load
+	for(long cpu=0; cpu<cpus; cpu++) {
+		std::ostringstream path;
+		path << "/sys/devices/system/cpu/cpu" << cpu << "/cpufreq/scaling_governor";
+		std::string governor = readFirstLine(path.str());
+		if(!governor.empty() && governor != "performance") {
+			std::ostringstream msg;
+			msg << "cpu" << cpu << " uses the " << governor << " frequency governor";
+			problems.push_back(msg.str());
+			break;
+		}
+	}
+
+	// Turbo: clock speed then depends on temperature and how many cores are busy
+	if(readFirstLine("/sys/devices/system/cpu/intel_pstate/no_turbo") == "0"
+		|| readFirstLine("/sys/devices/system/cpu/cpufreq/boost") == "1") {
+		problems.push_back("turbo boost is enabled");
+	}
+
+	// SMT: a sibling hardware thread shares the core's execution units with the benchmark
+	if(readFirstLine("/sys/devices/system/cpu/smt/active") == "1") {
+		problems.push_back("SMT is active, sibling threads share cores");
+	}
+
+	// Noisy neighbours: runnable tasks besides this one compete for the CPU
+	int others = otherRunnableTasks();
+	if(others > 0) {
+		std::ostringstream msg;
+		msg << others << " other runnable task" << (others == 1 ? "" : "s") << " on " << cpus << " CPUs";
+		problems.push_back(msg.str());
+	}
+
+	return problems;
+}
+
+/*
+ * Decides how many trials a timed loop runs and reports its timings
+ * Usage:
+ *   RunController run;
+ *   Sample e_time;
+ *   while(run.next()) { ... run.record(e_time, seconds); }
+ *   run.report("Avg encryption time", e_time);
+ *   run.finish();
+ * Table rows print stability() in a column instead of report() lines
+ */
+class RunController {
+public:
+	RunController() : trial(0), unstable(false), inlineStatus(false) {
+		warmup = (int) runSetting("BENCH_WARMUP", 1);
+		minTrials = (int) runSetting("BENCH_MIN_TRIALS", 5);
+		maxTrials = (int) runSetting("BENCH_MAX_TRIALS", 30);
+		ciTarget = runSetting("BENCH_CI_TARGET", 0.02);
+		strict = runSetting("BENCH_STRICT", 0) != 0;
+		if(minTrials < 2) {
+			minTrials = 2;
+		}
+		if(maxTrials < minTrials) {
+			maxTrials = minTrials;
+		}
+
+		checkHostOnce();
+	}
+
+	/*
+	 * Starts the next trial
+	 * Returns false once every recorded sample has converged, or the trial limit is reached
+	 */
+	bool next() {
+		int measured = trial - warmup;
+		if(measured >= maxTrials) {
+			return false;
+		}
+		if(measured >= minTrials && converged()) {
+			return false;
+		}
+		trial++;
+		return true;
+	}
+
+	// Trials completed so far, excluding warm-up
+	int trials() const {
+		return trial > warmup ? trial - warmup : 0;
+	}
+
+	/*
+	 * Records a timing from the current trial; ignored while warming up
+	 * @sample: sample the timing belongs to
+	 * @seconds: measured time
+	 */
+	void record(Sample& sample, double seconds) {
+		if(trial <= warmup) {
+			return;
+		}
+		bool tracked = false;
+		for(size_t i=0; i<samples.size(); i++) {
+			tracked = tracked || samples[i] == &sample;
+		}
+		if(!tracked) {
+			samples.push_back(&sample);
+		}
+		sample.add(seconds);
+	}
+
+	/*
+	 * Prints the mean of a sample with its confidence interval, flagging it if unconverged
+	 * @label: line label
+	 * @sample: sample to print
+	 */
+	void report(const std::string& label, const Sample& sample) {
+		std::cout << label << ": " << sample.mean() << " (+/-" << sample.relativeCI() * 100 << "%, "
+			<< sample.count() << " trials)" << markers(sample.relativeCI()) << std::endl;
+	}
+
+	/*
+	 * Prints a sample as a rate, with its confidence interval, flagging it if unconverged
+	 * @label: line label
+	 * @sample: time taken per trial
+	 * @units: units of work done per trial
+	 * @unit: name of the unit of work
+	 */
+	void reportRate(const std::string& label, const Sample& sample, double units, const std::string& unit) {
+		std::cout << label << ": " << units / sample.mean() << " " << unit << "/s (+/-"
+			<< sample.relativeCI() * 100 << "%, " << sample.count() << " trials)" << markers(sample.relativeCI()) << std::endl;
+	}
+
+	/*
+	 * Describes the stability of every recorded sample in one table cell: the widest confidence
+	 * interval, followed by the same markers as report()
+	 * finish() then leaves the warning to the cell rather than printing it between rows
+	 */
+	std::string stability() {
+		double widest = 0;
+		for(size_t i=0; i<samples.size(); i++) {
+			if(samples[i]->relativeCI() > widest) {
+				widest = samples[i]->relativeCI();
+			}
+		}
+
+		std::ostringstream cell;
+		cell << "+/-" << widest * 100 << "%" << markers(widest);
+		inlineStatus = true;
+		return cell.str();
+	}
+
+	/*
+	 * Ends the loop; warns if any sample did not converge and exits in strict mode
+	 */
+	void finish() {
+		if(!unstable && converged()) {
+			return;
+		}
+		if(!inlineStatus) {
+			std::cout << "Warning: timings did not converge to +/-" << ciTarget * 100 << "% within "
+				<< maxTrials << " trials" << std::endl;
+		}
+		if(strict) {
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	/*
+	 * Reports host problems the first time it is called; every controller calls it on construction
+	 * Programs that print a table call it before the heading so warnings do not land between rows
+	 */
+	static void checkHostOnce() {
+		static bool checked = false;
+		if(checked) {
+			return;
+		}
+		checked = true;
+
+		std::vector<std::string> problems = checkHost();
+		for(size_t i=0; i<problems.size(); i++) {
+			std::cout << "Warning: " << problems[i] << std::endl;
+		}
+		if(!problems.empty() && runSetting("BENCH_STRICT", 0) != 0) {
+			std::cout << "Refusing to run on a noisy host (BENCH_STRICT=1)." << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		noisyHost() = !problems.empty();
+	}
+
+private:
+	// True once checkHostOnce() has found a problem with the host
+	static bool& noisyHost() {
+		static bool noisy = false;
+		return noisy;
+	}
+
+	// Markers appended to a result: UNSTABLE if unconverged, NOISY-HOST if the host check failed
+	std::string markers(double relative_ci) {
+		std::string result;
+		if(relative_ci > ciTarget) {
+			result += " UNSTABLE";
+			unstable = true;
+		}
+		if(noisyHost()) {
+			result += " NOISY-HOST";
+		}
+		return result;
+	}
+
+	// True if every recorded sample is within the confidence interval target
+	bool converged() const {
+		for(size_t i=0; i<samples.size(); i++) {
+			if(samples[i]->relativeCI() > ciTarget) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	int trial;
+	int warmup;
+	int minTrials;
+	int maxTrials;
+	double ciTarget;
+	bool strict;
+	bool unstable;
+	bool inlineStatus;
+	std::vector<Sample*> samples;
+};
+
+#endif
@@ -10,21 +10,196 @@
 #include <memory>
 #include <limits>
 #include <ctime>
+#include <cstring>
+#include <cmath>
 
 #include "seal/seal.h"
-
-const int numTrials = 5;
+#include "fhematrix.h"
+#include "runcontrol.h"
+#include "verify.h"
 
 using namespace std;
 using namespace seal;
 
-int main() {
+/*
+ * Picks the default coeff_modulus for a security target
+ * @target: security target
+ */
+vector<SmallModulus> coeffModulusFor(const SecurityTarget& target) {
+	switch(target.bits) {
+		case 128:
+			return DefaultParams::coeff_modulus_128(target.seal_poly_degree);
+		case 192:
+			return DefaultParams::coeff_modulus_192(target.seal_poly_degree);
+		default:
+			return DefaultParams::coeff_modulus_256(target.seal_poly_degree);
+	}
+}
+
+// Formats the SEAL parameters of a matrix row
+// SEAL has no security estimator; the parameters come from the HE-standard DefaultParams table
+string describeParams(const SecurityTarget& target) {
+	int coeff_bits = 0;
+	for(const SmallModulus& mod : coeffModulusFor(target)) {
+		coeff_bits += mod.bit_count();
+	}
+	return "n=" + to_string(target.seal_poly_degree) + " log q=" + to_string(coeff_bits);
+}
+
+/*
+ * Runs the matrix workload with BFV at a security target
+ * Prints a matrix row with the average time of each operation
+ * @target: security target
+ */
+void timeBFVMatrixOp(const SecurityTarget& target) {
+	clock_t start;
+	RunController run;
+	Sample e_time, a_time, m_time, d_time;
+
+	EncryptionParameters parms(scheme_type::BFV);
+	parms.set_poly_modulus_degree(target.seal_poly_degree);
+	parms.set_coeff_modulus(coeffModulusFor(target));
+	parms.set_plain_modulus(1 << 8);
+
+	auto context = SEALContext::Create(parms);
+	IntegerEncoder encoder(context);
+
+	KeyGenerator keygen(context);
+	PublicKey public_key = keygen.public_key();
+	SecretKey secret_key = keygen.secret_key();
+	RelinKeys relin_keys = keygen.relin_keys(DefaultParams::dbc_max());
+
+	Encryptor encryptor(context, public_key);
+	Evaluator evaluator(context);
+	Decryptor decryptor(context, secret_key);
+
+	while(run.next()) {
+		Plaintext plain1 = encoder.encode(matrixOperandA);
+		Plaintext plain2 = encoder.encode(matrixOperandB);
+		Ciphertext encrypted1, encrypted2;
+
+		start = clock();
+		encryptor.encrypt(plain1, encrypted1);
+		run.record(e_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		start = clock();
+		encryptor.encrypt(plain2, encrypted2);
+		run.record(e_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		start = clock();
+		evaluator.add_inplace(encrypted1, encrypted2);
+		run.record(a_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		// Multiplication includes relinearisation back to a two-element ciphertext
+		start = clock();
+		evaluator.multiply_inplace(encrypted1, encrypted2);
+		evaluator.relinearize_inplace(encrypted1, relin_keys);
+		run.record(m_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		Plaintext plain_result;
+		start = clock();
+		decryptor.decrypt(encrypted1, plain_result);
+		run.record(d_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		verify(encoder.decode_int32(plain_result) == (matrixOperandA + matrixOperandB) * matrixOperandB, "BFV matrix workload");
+	}
+
+	printMatrixRow("SEAL", "BFV", target.bits, 0, describeParams(target).c_str(),
+		e_time.mean(), a_time.mean(), m_time.mean(), d_time.mean(), run.stability().c_str());
+	run.finish();
+}
+
+/*
+ * Runs the matrix workload with CKKS at a security target
+ * Prints a matrix row with the average time of each operation
+ * @target: security target
+ */
+void timeCKKSMatrixOp(const SecurityTarget& target) {
+	clock_t start;
+	RunController run;
+	Sample e_time, a_time, m_time, d_time;
+
+	EncryptionParameters parms(scheme_type::CKKS);
+	parms.set_poly_modulus_degree(target.seal_poly_degree);
+	parms.set_coeff_modulus(coeffModulusFor(target));
+
+	// Product of two operands must stay below the coefficient modulus without rescaling
+	double scale = pow(2.0, 20);
+
+	auto context = SEALContext::Create(parms);
+	CKKSEncoder encoder(context);
+
+	KeyGenerator keygen(context);
+	PublicKey public_key = keygen.public_key();
+	SecretKey secret_key = keygen.secret_key();
+	RelinKeys relin_keys = keygen.relin_keys(DefaultParams::dbc_max());
+
+	Encryptor encryptor(context, public_key);
+	Evaluator evaluator(context);
+	Decryptor decryptor(context, secret_key);
+
+	while(run.next()) {
+		Plaintext plain1, plain2;
+		encoder.encode(static_cast<double>(matrixOperandA), scale, plain1);
+		encoder.encode(static_cast<double>(matrixOperandB), scale, plain2);
+		Ciphertext encrypted1, encrypted2;
+
+		start = clock();
+		encryptor.encrypt(plain1, encrypted1);
+		run.record(e_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		start = clock();
+		encryptor.encrypt(plain2, encrypted2);
+		run.record(e_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		start = clock();
+		evaluator.add_inplace(encrypted1, encrypted2);
+		run.record(a_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		// Multiplication includes relinearisation back to a two-element ciphertext
+		start = clock();
+		evaluator.multiply_inplace(encrypted1, encrypted2);
+		evaluator.relinearize_inplace(encrypted1, relin_keys);
+		run.record(m_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		Plaintext plain_result;
+		start = clock();
+		decryptor.decrypt(encrypted1, plain_result);
+		run.record(d_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		vector<double> result;
+		encoder.decode(plain_result, result);
+		verify(fabs(result[0] - (matrixOperandA + matrixOperandB) * matrixOperandB) < 0.5, "CKKS matrix workload");
+	}
+
+	printMatrixRow("SEAL", "CKKS", target.bits, 0, describeParams(target).c_str(),
+		e_time.mean(), a_time.mean(), m_time.mean(), d_time.mean(), run.stability().c_str());
+	run.finish();
+}
+
+/*
+ * Usage: sealtest [--matrix]
+ * --matrix runs the cross-library parameter matrix instead of the 2048-degree BFV benchmark
+ */
+int main(int argc, char *argv[]) {
+	if(argc > 1 && strcmp(argv[1], "--matrix") == 0) {
+		RunController::checkHostOnce();
+		printMatrixHeader();
+		for(int i=0; i<numSecurityTargets; i++) {
+			timeBFVMatrixOp(securityTargets[i]);
+			timeCKKSMatrixOp(securityTargets[i]);
+		}
+		return 0;
+	}
+
 	clock_t start;
-	double add_duration, e_duration, d_duration;
 
 	cout << "=========================================================================" << endl;
 	cout << "BFV using Microsoft SEAL." << endl;
 
+	RunController run;
+	Sample e_time, add_time, d_time;
+
 	/* 
 	 * Set up an instance of the EncryptionParameters class; 5 params
 	 * 
@@ -75,7 +250,7 @@ int main() {
 	// Get an instance of decryptor to decrypt
 	Decryptor decryptor(context, secret_key);
 
-	for(int i=0; i<numTrials; i++) {
+	while(run.next()) {
 
 		// Encode two integers as plaintext polynomials
 		int value1 = 7;
@@ -88,30 +263,33 @@ int main() {
 
 		start = clock();
 		encryptor.encrypt(plain1, encrypted1);
-		e_duration = e_duration + ( clock() - start ) / (double) CLOCKS_PER_SEC;
+		run.record(e_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
 
 		start = clock();
 		encryptor.encrypt(plain2, encrypted2);
-		e_duration = e_duration + ( clock() - start ) / (double) CLOCKS_PER_SEC;
+		run.record(e_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
 
 		// Perform addition on ciphertext
 		start = clock();
 		evaluator.add_inplace(encrypted1, encrypted2);
-		add_duration = add_duration + ( clock() - start ) / (double) CLOCKS_PER_SEC;
+		run.record(add_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
 
 		// Decrypt and decode
 		Plaintext plain_result;
 
 		start = clock();
 		decryptor.decrypt(encrypted1, plain_result);
-		d_duration = d_duration + ( clock() - start ) / (double) CLOCKS_PER_SEC;
+		run.record(d_time, ( clock() - start ) / (double) CLOCKS_PER_SEC);
+
+		verify(encoder.decode_int32(plain_result) == value1 + value2, "BFV addition");
 		
 	}
 
-	// Divide by 10 because encrypting 2 numbers 5 times each
-	cout << "Avg encryption time: " << e_duration/(numTrials*2) << endl;
-	cout << "Avg decryption time: " << d_duration/numTrials << endl;
-	cout << "Avg addition time: " << add_duration/numTrials << endl;
+	// Two encryptions are recorded per trial, so this is the average of a single encryption
+	run.report("Avg encryption time", e_time);
+	run.report("Avg decryption time", d_time);
+	run.report("Avg addition time", add_time);
+	run.finish();
 
 	cout << "=========================================================================" << endl << endl;
 }
\ No newline at end of file
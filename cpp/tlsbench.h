@@ -0,0 +1,157 @@
+#ifndef TLSBENCH_H
+#define TLSBENCH_H
+
+#include <iostream>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+/*
+ * Loopback TLS load shared by openssltlstest and botantlstest
+ * Every connection has its own client thread and server thread talking over 127.0.0.1 TCP
+ */
+
+// Concurrent connections to sweep
+const int connectionCounts[] = { 1, 4, 16 };
+
+// Handshakes each client performs per trial
+const int handshakesPerConnection = 100;
+
+// Application data each client sends per trial in the bulk runs, in maximum-size records
+const size_t bulkBytesPerConnection = 16 * 1048576;
+const size_t recordSize = 16384;
+
+/*
+ * Opens a listening TCP socket on 127.0.0.1 with an ephemeral port
+ * Exits on failure
+ * @port: set to the chosen port
+ */
+inline int listenLoopback(int *port) {
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	socklen_t addr_len = sizeof(addr);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+
+	if(fd < 0 || bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0
+		|| getsockname(fd, (struct sockaddr *) &addr, &addr_len) != 0) {
+		std::cout << "Could not listen on the loopback interface." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	*port = ntohs(addr.sin_port);
+	return fd;
+}
+
+// Disables Nagle's algorithm so small handshake flights are not delayed
+inline void setNoDelay(int fd) {
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+/*
+ * Connects to a loopback port
+ * Exits on failure
+ * @port: port to connect to
+ */
+inline int connectLoopback(int port) {
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+
+	if(fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+		std::cout << "Could not connect to the loopback server." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	setNoDelay(fd);
+	return fd;
+}
+
+/*
+ * Accepts a connection, returning -1 once the listening socket has been shut down
+ * @listen_fd: listening socket
+ */
+inline int acceptLoopback(int listen_fd) {
+	int fd = accept(listen_fd, NULL, NULL);
+	if(fd >= 0) {
+		setNoDelay(fd);
+	}
+	return fd;
+}
+
+// Wakes threads blocked in accept and closes the listening socket
+inline void closeListener(int listen_fd) {
+	shutdown(listen_fd, SHUT_RDWR);
+	close(listen_fd);
+}
+
+/*
+ * Handshake latencies
+ * Keeps every latency for exact percentiles, and prints a log2 histogram
+ */
+class LatencyHistogram {
+public:
+	void add(double seconds) {
+		latencies.push_back(seconds);
+	}
+
+	void merge(const LatencyHistogram& other) {
+		latencies.insert(latencies.end(), other.latencies.begin(), other.latencies.end());
+	}
+
+	// Latency below which a fraction of the samples fall
+	double percentile(double fraction) {
+		if(latencies.empty()) {
+			return 0;
+		}
+		std::sort(latencies.begin(), latencies.end());
+		size_t index = (size_t) (fraction * (latencies.size() - 1));
+		return latencies[index];
+	}
+
+	/*
+	 * Prints percentiles, then the number of samples in each power-of-two microsecond bucket
+	 * @label: line label
+	 */
+	void print(const std::string& label) {
+		std::cout << label << " latency: p50 " << percentile(0.5) << ", p90 " << percentile(0.9)
+			<< ", p99 " << percentile(0.99) << ", max " << percentile(1.0) << std::endl;
+
+		std::vector<size_t> buckets;
+		for(size_t i=0; i<latencies.size(); i++) {
+			double us = latencies[i] * 1e6;
+			size_t bucket = us <= 1 ? 0 : (size_t) ceil(log2(us));
+			if(bucket >= buckets.size()) {
+				buckets.resize(bucket + 1, 0);
+			}
+			buckets[bucket]++;
+		}
+
+		std::cout << label << " histogram:";
+		for(size_t i=0; i<buckets.size(); i++) {
+			if(buckets[i] > 0) {
+				std::cout << " <=" << (1UL << i) << "us:" << buckets[i];
+			}
+		}
+		std::cout << std::endl;
+	}
+
+private:
+	std::vector<double> latencies;
+};
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+
+/*
+ * Correctness checks shared by the C++ benchmarks
+ * Timed results are passed through sinks the compiler cannot see into, so work whose output is
+ * never read is still performed, and outputs are checked against known answers or the plaintext.
+ * A failed check ends the program: a fast number for a wrong result is worse than none.
+ */
+
+// Makes the compiler assume the memory behind p is read, so writes to it cannot be elided
+inline void doNotOptimize(const void* p) {
+	__asm__ __volatile__("" : : "r"(p) : "memory");
+}
+
+// Makes the compiler assume a value is used
+template <typename T>
+inline void sink(const T& value) {
+	doNotOptimize(&value);
+}
+
+/*
+ * Exits with an error if a check fails
+ * @ok: result of the check
+ * @what: description of what was checked
+ */
+inline void verify(bool ok, const std::string& what) {
+	if(!ok) {
+		std::cout << "Verification failed: " << what << std::endl;
+		exit(EXIT_FAILURE);
+	}
+}
+
+// True if two buffers have the same length and contents
+inline bool sameBytes(const void* a, size_t a_len, const void* b, size_t b_len) {
+	return a_len == b_len && memcmp(a, b, a_len) == 0;
+}
+
+// Decodes a hex string of a known-answer vector
+inline std::vector<unsigned char> fromHex(const char* hex) {
+	std::vector<unsigned char> bytes;
+	for(size_t i=0; hex[i] != '\0' && hex[i+1] != '\0'; i+=2) {
+		char byte[3] = { hex[i], hex[i+1], '\0' };
+		bytes.push_back((unsigned char) strtoul(byte, NULL, 16));
+	}
+	return bytes;
+}
+
+/*
+ * Known-answer vectors
+ */
+
+// FIPS-197 appendix C.3, AES-256
+const char aes256KatKey[] = "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f";
+const char aes256KatPlaintext[] = "00112233445566778899aabbccddeeff";
+const char aes256KatCiphertext[] = "8ea2b7ca516745bfeafc49904b496089";
+
+// RFC 7539 section 2.4.2, ChaCha20 with block counter 1
+const char chachaKatKey[] = "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f";
+const char chachaKatNonce[] = "000000000000004a00000000";
+const char chachaKatPlaintext[] = "Ladies and Gentlemen of the class of '99: If I could offer you only one tip for the future, sunscreen would be it.";
+const char chachaKatCiphertext[] =
+	"6e2e359a2568f98041ba0728dd0d6981e97e7aec1d4360c20a27afccfd9fae0b"
+	"f91b65c5524733ab8f593dabcd62b3571639d624e65152ab8f530c359f0861d8"
+	"07ca0dbf500d6a6156a38e088a22b65e52bc514d16ccf806818ce91ab7793736"
+	"5af90bbf74a35be6b40b8eedf2785e42874d";
+
+// FIPS 180-2 appendix B.1, SHA-256 of "abc"
+const char sha256KatMessage[] = "abc";
+const char sha256KatDigest[] = "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad";
+
+// RFC 7914 section 11, PBKDF2-HMAC-SHA256 with one iteration
+const char pbkdf2KatPassword[] = "passwd";
+const char pbkdf2KatSalt[] = "salt";
+const unsigned long pbkdf2KatIterations = 1;
+const char pbkdf2KatKey[] =
+	"55ac046e56e3089fec1691c22544b605f94185216dde0465e68b9d57c20dacbc"
+	"49ca9cccf179b645991664b39d77ef317c71b845b1e30bd509112041d3a19783";
+
+// RFC 7914 section 12, scrypt with N=1024, r=8, p=16
+const char scryptKatPassword[] = "password";
+const char scryptKatSalt[] = "NaCl";
+const unsigned long scryptKatN = 1024, scryptKatR = 8, scryptKatP = 16;
+const char scryptKatKey[] =
+	"fdbabe1c9d3472007856e7190d01e9fe7c6ad7cbc8237830e77376634b373162"
+	"2eaf30d92e22a3886ff109279d9830dac727afb94a83ee6d8360cbdfa2cc0640";
+
+// Argon2 reference implementation test vector, Argon2id v1.3 with t=2, m=64 MiB, p=1
+const char argon2idKatPassword[] = "password";
+const char argon2idKatSalt[] = "somesalt";
+const unsigned long argon2idKatMemory = 65536, argon2idKatIterations = 2, argon2idKatLanes = 1;
+const char argon2idKatKey[] = "09316115d5cf24ed5a15a31a3ba326e5cf32edc24702987c02b6566f61913cf7";
+
+// RFC 5869 appendix A.1, HKDF-SHA256
+const char hkdfKatKey[] = "0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b";
+const char hkdfKatSalt[] = "000102030405060708090a0b0c";
+const char hkdfKatInfo[] = "f0f1f2f3f4f5f6f7f8f9";
+const char hkdfKatOutput[] = "3cb25f25faacd57a90434f64d0362f2a2d2d0a90cf1a5a4c5db02d56ecc4c5bf34007208d5b887185865";
+
+#endif